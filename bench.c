@@ -0,0 +1,133 @@
+//
+// Created by dbrent on 3/6/21.
+//
+// Headless driver for libsand: pours grains from a few spouts and times
+// sim_step() without a window, so it runs on build boxes with no GL.
+//
+// sand_bench [--ticks N] [--settle N] [--workers N] [--engine cells]
+//            [--seed N] [--pan N] [--resident N]
+//
+// --pan moves the window N cells to the right every pour tick, leaving the
+// piles behind in the world's chunk store. --resident caps the chunks it
+// keeps in memory, the rest go to sand_bench.world until the run ends.
+//
+// the grid layout is fixed at build time, compare layouts by configuring
+// one build per -DSAND_GRID_LAYOUT=rows|tiled|morton and running each.
+//
+
+#include "sim.h"
+#include "chunk.h"
+#include "rng.h"
+#include "scan.h"
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0;
+}
+
+// fnv-1a over sim_materials(). the sim promises the same result for any
+// --workers and SAND_GRID_LAYOUT, so runs that differ only in those have to
+// print the same hash.
+static uint32_t materials_hash() {
+    uint8_t *materials = malloc(W_WIDTH * W_HEIGHT);
+    checkm(materials);
+    sim_materials(materials);
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < W_WIDTH * W_HEIGHT; i++) {
+        hash = (hash ^ materials[i]) * 16777619u;
+    }
+    free(materials);
+    return hash;
+}
+
+static void pour(int ticks, int pan, double *total, double *moving) {
+    for (int t = 0; t < ticks; t++) {
+        if (pan) {
+            double start = now_ms();
+            world_follow(W_WIDTH / 2.0 + (double) t * pan, W_HEIGHT / 2.0);
+            *moving += now_ms() - start;
+        }
+        for (int s = 1; s < 8; s++) {
+            brush_t brush;
+            brush.shape = BRUSH_RECT;
+            brush.x = W_WIDTH * s / 8;
+            brush.y = 100;
+            brush.radius = 50;
+            // ~64 grains per spout
+            brush.density = 0.0064f;
+            brush.material = s % 2 ? SAND : WATER;
+            pixel_add_batch(&brush);
+        }
+        double start = now_ms();
+        sim_step();
+        *total += now_ms() - start;
+    }
+}
+
+int main(int argc, char **argv) {
+    int ticks = 600;
+    int settle = 600;
+    int workers = 1;
+    int pan = 0;
+    for (int a = 1; a + 1 < argc; a += 2) {
+        if (strcmp(argv[a], "--ticks") == 0) {
+            ticks = atoi(argv[a + 1]);
+        } else if (strcmp(argv[a], "--settle") == 0) {
+            settle = atoi(argv[a + 1]);
+        } else if (strcmp(argv[a], "--workers") == 0) {
+            workers = atoi(argv[a + 1]);
+        } else if (strcmp(argv[a], "--pan") == 0) {
+            pan = atoi(argv[a + 1]);
+        } else if (strcmp(argv[a], "--resident") == 0) {
+            world_resident_limit = atoi(argv[a + 1]);
+        } else if (strcmp(argv[a], "--seed") == 0) {
+            rng_global_seed = strtoull(argv[a + 1], NULL, 10);
+        } else if (strcmp(argv[a], "--engine") == 0) {
+            sim_engine = strcmp(argv[a + 1], "cells") == 0 ? ENGINE_CELLS
+                                                           : ENGINE_PARTICLES;
+        }
+    }
+
+    sim_init();
+    sim_set_workers(workers);
+    world_init("sand_bench.world");
+
+    double pour_ms = 0.0;
+    double settle_ms = 0.0;
+    double pan_ms = 0.0;
+    pour(ticks, pan, &pour_ms, &pan_ms);
+    for (int t = 0; t < settle; t++) {
+        double start = now_ms();
+        sim_step();
+        settle_ms += now_ms() - start;
+    }
+
+    printf("engine: %s, workers: %d, scan: %s, grid: %s, seed: %llu\n",
+           sim_engine == ENGINE_CELLS ? "cells" : "particles", workers,
+           scan_isa(), GRID_LAYOUT, (unsigned long long) rng_global_seed);
+    printf("pour:   %d ticks, %.3f ms/tick\n", ticks,
+           ticks ? pour_ms / ticks : 0.0);
+    printf("settle: %d ticks, %.3f ms/tick\n", settle,
+           settle ? settle_ms / settle : 0.0);
+    printf("pixels: %d/%d, updated last tick: %d, awake chunks: %d/%d\n",
+           pixel_count, MAX_PIXELS, sim_updated(), chunks_awake(),
+           CHUNK_COUNT);
+    printf("materials hash: %08x\n", materials_hash());
+    if (pan) {
+        printf("world:  origin %lld, %.3f ms/tick moving, chunks: %d in "
+               "memory, %d on disk\n", (long long) world_origin_x,
+               ticks ? pan_ms / ticks : 0.0, world_chunks_resident(),
+               world_chunks_evicted());
+    }
+
+    world_terminate();
+    sim_terminate();
+    return 0;
+}
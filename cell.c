@@ -0,0 +1,180 @@
+//
+// Created by dbrent on 3/18/21.
+//
+
+#include "cell.h"
+#include "chunk.h"
+#include "scan.h"
+
+#include <string.h>
+
+uint8_t cells[W_WIDTH * W_HEIGHT];
+
+void cells_init() {
+    memset(cells, CELL_EMPTY, sizeof(cells));
+}
+
+// cells outside the world count as occupied so probes never leave the grid
+static bool cell_free(int x, int y) {
+    if (x < 0 || x >= W_WIDTH || y < 0 || y >= W_HEIGHT) {
+        return false;
+    }
+    return (cells[x + y * W_WIDTH] & CELL_MATERIAL) == CELL_EMPTY;
+}
+
+// whether x, y holds a material lighter than density
+static bool cell_lighter(int x, int y, int density) {
+    if (y >= W_HEIGHT) {
+        return false;
+    }
+    uint8_t material = cells[x + y * W_WIDTH] & CELL_MATERIAL;
+    return material != CELL_EMPTY &&
+           material_table[material - 1].density < density;
+}
+
+static int cell_distance(int x, int y, int step_x, int step_y, int reach) {
+    // clip the run to the world so scan_free never leaves cells[]
+    int limit = reach - 1;
+    if (step_x < 0 && x < limit) { limit = x; }
+    if (step_x > 0 && W_WIDTH - 1 - x < limit) { limit = W_WIDTH - 1 - x; }
+    if (step_y > 0 && W_HEIGHT - 1 - y < limit) { limit = W_HEIGHT - 1 - y; }
+    int stride = step_x + step_y * W_WIDTH;
+    int distance = scan_free(cells, x + y * W_WIDTH + stride, stride, limit);
+    // the chosen neighbour is free, so a grain always moves at least one cell
+    return distance < 1 ? 1 : distance;
+}
+
+bool cell_add(int x, int y, pixel_type_e type) {
+    if (!cell_free(x, y)) {
+        return false;
+    }
+    cells[x + y * W_WIDTH] = (uint8_t) (type + 1);
+    chunk_wake(chunk_index(x, y), x, y);
+    return true;
+}
+
+static void cell_update(int source, int x, int y, uint8_t parity) {
+    int position = x + y * W_WIDTH;
+    uint8_t material = cells[position] & CELL_MATERIAL;
+    const material_t *m = &material_table[material - 1];
+    int dx = 0;
+    int dy = 0;
+
+    if ((m->moves & MOVE_DOWN) && cell_free(x, y + 1)) {
+        dy = cell_distance(x, y, 0, 1, m->fall);
+    } else if ((m->moves & MOVE_SINK) && cell_lighter(x, y + 1, m->density)) {
+        // trade places with the lighter material below, which counts as
+        // moved so it isn't stepped again this tick
+        int below = position + W_WIDTH;
+        cells[position] = (cells[below] & CELL_MATERIAL) | CELL_MOVED | parity;
+        cells[below] = material | CELL_MOVED | parity;
+        chunk_wake(source, x, y);
+        chunk_wake(source, x, y + 1);
+        return;
+    } else if ((m->moves & MOVE_DIAGONAL) && cell_free(x - 1, y + 1)) {
+        dx = dy = cell_distance(x, y, -1, 1, m->friction);
+        dx = -dx;
+    } else if ((m->moves & MOVE_DIAGONAL) && cell_free(x + 1, y + 1)) {
+        dx = dy = cell_distance(x, y, 1, 1, m->friction);
+    } else if ((m->moves & MOVE_SIDEWAYS) && cell_free(x - 1, y)) {
+        dx = -cell_distance(x, y, -1, 0, m->spread);
+    } else if ((m->moves & MOVE_SIDEWAYS) && cell_free(x + 1, y)) {
+        dx = cell_distance(x, y, 1, 0, m->spread);
+    }
+
+    if (dx == 0 && dy == 0) {
+        cells[position] = material;
+        return;
+    }
+
+    cells[(x + dx) + (y + dy) * W_WIDTH] = material | CELL_MOVED | parity;
+    cells[position] = CELL_EMPTY;
+    chunk_wake(source, x, y);
+    chunk_wake(source, x + dx, y + dy);
+}
+
+int cells_step_chunk(int source, bool left_to_right) {
+    const rect_t *r = &chunks[source].dirty;
+    uint8_t parity = sim_tick % 2 ? CELL_PARITY : 0;
+    int count = 0;
+    for (int y = r->max_y; y >= r->min_y; y--) {
+        for (int n = 0; n <= r->max_x - r->min_x; n++) {
+            int x = left_to_right ? r->min_x + n : r->max_x - n;
+            uint8_t cell = cells[x + y * W_WIDTH];
+            if ((cell & CELL_MATERIAL) == CELL_EMPTY) {
+                continue;
+            }
+            // every landing cell is woken, so a moved flag is always cleared
+            // or refreshed on the next tick and its parity can't go stale
+            if ((cell & CELL_MOVED) && (cell & CELL_PARITY) == parity) {
+                continue;
+            }
+            cell_update(source, x, y, parity);
+            count++;
+        }
+    }
+    return count;
+}
+
+int cells_shift(int dx, int dy) {
+    int width = W_WIDTH - (dx < 0 ? -dx : dx);
+    int count = 0;
+    // walk against the shift so every source row is read before it is
+    // overwritten
+    for (int n = 0; n < W_HEIGHT; n++) {
+        int y = dy > 0 ? W_HEIGHT - 1 - n : n;
+        uint8_t *row = cells + y * W_WIDTH;
+        if (y - dy < 0 || y - dy >= W_HEIGHT || width <= 0) {
+            memset(row, CELL_EMPTY, W_WIDTH);
+            continue;
+        }
+        const uint8_t *from = cells + (y - dy) * W_WIDTH;
+        if (dx >= 0) {
+            memmove(row + dx, from, width);
+            memset(row, CELL_EMPTY, dx);
+        } else {
+            memmove(row, from - dx, width);
+            memset(row + width, CELL_EMPTY, -dx);
+        }
+        for (int x = 0; x < W_WIDTH; x++) {
+            count += (row[x] & CELL_MATERIAL) != CELL_EMPTY;
+        }
+    }
+    chunks_shift(dx, dy);
+    return count;
+}
+
+void cells_materials(uint8_t *materials) {
+    for (int i = 0; i < W_WIDTH * W_HEIGHT; i++) {
+        materials[i] = cells[i] & CELL_MATERIAL;
+    }
+}
+
+int cells_instances(pixel_instance_t *instances) {
+    int count = 0;
+    for (int y = 0; y < W_HEIGHT; y++) {
+        for (int x = 0; x < W_WIDTH; x++) {
+            uint8_t material = cells[x + y * W_WIDTH] & CELL_MATERIAL;
+            if (material != CELL_EMPTY) {
+                instances[count++] = PIXEL_INSTANCE(x, y, material);
+            }
+        }
+    }
+    return count;
+}
+
+int cells_vertices(pixel_vertex_t *vertices, pixel_colour_t *colours) {
+    int count = 0;
+    for (int y = 0; y < W_HEIGHT; y++) {
+        for (int x = 0; x < W_WIDTH; x++) {
+            uint8_t material = cells[x + y * W_WIDTH] & CELL_MATERIAL;
+            if (material == CELL_EMPTY) {
+                continue;
+            }
+            vertex_quad(vertices + count, x, y);
+            colour_quad(colours + count, material_table[material - 1].rgb);
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,52 @@
+//
+// Created by dbrent on 3/18/21.
+//
+
+#ifndef SAND_CELL_H
+#define SAND_CELL_H
+
+#include "sim.h"
+
+#include <stdint.h>
+
+// cellular automaton engine: the grid stores the material itself, one byte
+// per cell, and there is no particle identity to keep in sync.
+// material is pixel_type_e + 1 so that 0 is an empty cell.
+#define CELL_EMPTY 0
+#define CELL_MATERIAL 0x0f
+
+// materials are stored + 1 in the low nibble. the renderers' 16 entry
+// palettes and PIXEL_INSTANCE rely on the same limit.
+_Static_assert(PIXEL_TYPES <= CELL_MATERIAL,
+               "materials don't fit in CELL_MATERIAL");
+
+// set on the landing cell of a move together with the tick parity, so the
+// grain is not moved again if the scan reaches it later in the same tick
+#define CELL_MOVED 0x40
+#define CELL_PARITY 0x80
+
+extern uint8_t cells[W_WIDTH * W_HEIGHT];
+
+void cells_init();
+
+// returns false if the cell is outside the world or already occupied
+bool cell_add(int x, int y, pixel_type_e type);
+
+// steps every cell inside chunk source's dirty rect, bottom-up, and returns
+// how many it updated
+int cells_step_chunk(int source, bool left_to_right);
+
+// moves every cell by dx, dy, emptying the ones shifted in from outside the
+// world, and returns the number of grains left
+int cells_shift(int dx, int dy);
+
+// copies the material of every cell without the flag bits
+void cells_materials(uint8_t *materials);
+
+// writes an instance record for every occupied cell and returns the count
+int cells_instances(pixel_instance_t *instances);
+
+// writes a quad for every occupied cell and returns the number of quads
+int cells_vertices(pixel_vertex_t *vertices, pixel_colour_t *colours);
+
+#endif //SAND_CELL_H
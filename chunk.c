@@ -0,0 +1,160 @@
+//
+// Created by dbrent on 3/9/21.
+//
+
+#include "chunk.h"
+
+chunk_t chunks[CHUNK_COUNT];
+
+static void rect_clear(rect_t *r) {
+    r->min_x = W_WIDTH;
+    r->min_y = W_HEIGHT;
+    r->max_x = -1;
+    r->max_y = -1;
+}
+
+static void rect_expand(rect_t *r, int min_x, int min_y, int max_x,
+                        int max_y) {
+    if (min_x < r->min_x) { r->min_x = min_x; }
+    if (min_y < r->min_y) { r->min_y = min_y; }
+    if (max_x > r->max_x) { r->max_x = max_x; }
+    if (max_y > r->max_y) { r->max_y = max_y; }
+}
+
+void chunks_init() {
+    for (int i = 0; i < CHUNK_COUNT; i++) {
+        rect_clear(&chunks[i].dirty);
+        for (int n = 0; n < 9; n++) {
+            rect_clear(&chunks[i].next[n]);
+        }
+    }
+}
+
+void chunks_swap() {
+    for (int i = 0; i < CHUNK_COUNT; i++) {
+        chunk_t *chunk = &chunks[i];
+        rect_clear(&chunk->dirty);
+        for (int n = 0; n < 9; n++) {
+            rect_t *r = &chunk->next[n];
+            if (r->min_x <= r->max_x) {
+                rect_expand(&chunk->dirty, r->min_x, r->min_y, r->max_x,
+                            r->max_y);
+                rect_clear(r);
+            }
+        }
+    }
+}
+
+int chunk_index(int x, int y) {
+    return x / CHUNK_SIZE + (y / CHUNK_SIZE) * CHUNKS_X;
+}
+
+int chunk_phase(int index) {
+    return (index % CHUNKS_X) % 2 + ((index / CHUNKS_X) % 2) * 2;
+}
+
+void chunks_schedule(int phase_chunks[4][CHUNK_COUNT], int phase_count[4],
+                     bool left_to_right) {
+    for (int p = 0; p < 4; p++) {
+        phase_count[p] = 0;
+    }
+    for (int cy = CHUNKS_Y - 1; cy >= 0; cy--) {
+        for (int n = 0; n < CHUNKS_X; n++) {
+            int cx = left_to_right ? n : CHUNKS_X - 1 - n;
+            int index = cx + cy * CHUNKS_X;
+            if (chunk_awake(&chunks[index])) {
+                int p = chunk_phase(index);
+                phase_chunks[p][phase_count[p]++] = index;
+            }
+        }
+    }
+}
+
+void chunk_wake(int source, int x, int y) {
+    int source_cx = source % CHUNKS_X;
+    int source_cy = source / CHUNKS_X;
+    int min_x = x > 0 ? x - 1 : 0;
+    int min_y = y > 0 ? y - 1 : 0;
+    int max_x = x < W_WIDTH - 1 ? x + 1 : W_WIDTH - 1;
+    int max_y = y < W_HEIGHT - 1 ? y + 1 : W_HEIGHT - 1;
+
+    // a 3x3 area touches at most four chunks
+    for (int cy = min_y / CHUNK_SIZE; cy <= max_y / CHUNK_SIZE; cy++) {
+        for (int cx = min_x / CHUNK_SIZE; cx <= max_x / CHUNK_SIZE; cx++) {
+            int chunk_min_x = cx * CHUNK_SIZE;
+            int chunk_min_y = cy * CHUNK_SIZE;
+            int chunk_max_x = chunk_min_x + CHUNK_SIZE - 1;
+            int chunk_max_y = chunk_min_y + CHUNK_SIZE - 1;
+            int slot = (source_cx - cx + 1) + (source_cy - cy + 1) * 3;
+            rect_expand(&chunks[cx + cy * CHUNKS_X].next[slot],
+                        min_x > chunk_min_x ? min_x : chunk_min_x,
+                        min_y > chunk_min_y ? min_y : chunk_min_y,
+                        max_x < chunk_max_x ? max_x : chunk_max_x,
+                        max_y < chunk_max_y ? max_y : chunk_max_y);
+        }
+    }
+}
+
+// adds the rect, already clipped to the world, to the own slot of every
+// chunk it covers
+static void wake_clipped(int min_x, int min_y, int max_x, int max_y) {
+    for (int cy = min_y / CHUNK_SIZE; cy <= max_y / CHUNK_SIZE; cy++) {
+        for (int cx = min_x / CHUNK_SIZE; cx <= max_x / CHUNK_SIZE; cx++) {
+            int chunk_min_x = cx * CHUNK_SIZE;
+            int chunk_min_y = cy * CHUNK_SIZE;
+            int chunk_max_x = chunk_min_x + CHUNK_SIZE - 1;
+            int chunk_max_y = chunk_min_y + CHUNK_SIZE - 1;
+            // slot 4 is the chunk's own
+            rect_expand(&chunks[cx + cy * CHUNKS_X].next[4],
+                        min_x > chunk_min_x ? min_x : chunk_min_x,
+                        min_y > chunk_min_y ? min_y : chunk_min_y,
+                        max_x < chunk_max_x ? max_x : chunk_max_x,
+                        max_y < chunk_max_y ? max_y : chunk_max_y);
+        }
+    }
+}
+
+void chunk_wake_rect(int min_x, int min_y, int max_x, int max_y) {
+    wake_clipped(min_x > 0 ? min_x - 1 : 0, min_y > 0 ? min_y - 1 : 0,
+                 max_x < W_WIDTH - 1 ? max_x + 1 : W_WIDTH - 1,
+                 max_y < W_HEIGHT - 1 ? max_y + 1 : W_HEIGHT - 1);
+}
+
+void chunks_shift(int dx, int dy) {
+    static rect_t pending[CHUNK_COUNT * 9];
+    int count = 0;
+    for (int i = 0; i < CHUNK_COUNT; i++) {
+        rect_clear(&chunks[i].dirty);
+        for (int n = 0; n < 9; n++) {
+            rect_t *r = &chunks[i].next[n];
+            if (r->min_x <= r->max_x) {
+                pending[count++] = *r;
+                rect_clear(r);
+            }
+        }
+    }
+    for (int p = 0; p < count; p++) {
+        rect_t r = pending[p];
+        r.min_x = r.min_x + dx > 0 ? r.min_x + dx : 0;
+        r.min_y = r.min_y + dy > 0 ? r.min_y + dy : 0;
+        r.max_x = r.max_x + dx < W_WIDTH - 1 ? r.max_x + dx : W_WIDTH - 1;
+        r.max_y = r.max_y + dy < W_HEIGHT - 1 ? r.max_y + dy : W_HEIGHT - 1;
+        if (r.min_x <= r.max_x && r.min_y <= r.max_y) {
+            wake_clipped(r.min_x, r.min_y, r.max_x, r.max_y);
+        }
+    }
+}
+
+bool chunk_awake(const chunk_t *chunk) {
+    return chunk->dirty.min_x <= chunk->dirty.max_x;
+}
+
+int chunks_awake() {
+    int awake = 0;
+    for (int i = 0; i < CHUNK_COUNT; i++) {
+        if (chunk_awake(&chunks[i])) {
+            awake++;
+        }
+    }
+    return awake;
+}
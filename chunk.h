@@ -0,0 +1,77 @@
+//
+// Created by dbrent on 3/9/21.
+//
+
+#ifndef SAND_CHUNK_H
+#define SAND_CHUNK_H
+
+#include "sim.h"
+
+#define CHUNK_SIZE 64
+#define CHUNKS_X ((W_WIDTH + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define CHUNKS_Y ((W_HEIGHT + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define CHUNK_COUNT (CHUNKS_X * CHUNKS_Y)
+
+// chunks of the same phase are one chunk apart, and chunk_wake() needs a
+// grain to stay within reach of its own chunk. a move has to stay well
+// under half a chunk for both.
+_Static_assert(MATERIAL_REACH < CHUNK_SIZE / 2,
+               "materials reach across a chunk");
+
+// inclusive cell rectangle, empty when min_x > max_x
+typedef struct {
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+} rect_t;
+
+// a chunk only simulates the cells inside its dirty rect. anything that
+// moves or changes during a tick wakes its neighbourhood into next, which
+// becomes the dirty rect on the following tick. next has one slot per
+// neighbouring chunk that can raise a wake, so chunks stepped in parallel
+// never write the same rect.
+typedef struct {
+    rect_t dirty;
+    rect_t next[9];
+} chunk_t;
+
+extern chunk_t chunks[CHUNK_COUNT];
+
+void chunks_init();
+
+// promotes every chunk's next rect to its dirty rect and clears next
+void chunks_swap();
+
+int chunk_index(int x, int y);
+
+// marks the 3x3 neighbourhood around cell x, y dirty for the next tick on
+// behalf of chunk source, which must be the chunk being stepped (or the
+// chunk holding the cell outside of a step). the cell has to lie within
+// CHUNK_SIZE - 1 cells of the source chunk.
+void chunk_wake(int source, int x, int y);
+
+// marks min_x, min_y .. max_x, max_y grown by one cell dirty for the next
+// tick in every chunk it covers. only for use outside of a step, each
+// chunk raises the wake on its own behalf.
+void chunk_wake_rect(int min_x, int min_y, int max_x, int max_y);
+
+// moves the wakes pending for the next tick by dx, dy cells along with the
+// grains, dropping what leaves the world. only for use outside of a step.
+void chunks_shift(int dx, int dy);
+
+// 0..3, chunks in the same phase are at least one chunk apart
+int chunk_phase(int index);
+
+// sorts the awake chunks into the four checkerboard phases, bottom row
+// first. a grain reaches well under a chunk, so chunks of the same phase
+// never touch the same cells and can be stepped on any worker in any order
+// with the same result.
+void chunks_schedule(int phase_chunks[4][CHUNK_COUNT], int phase_count[4],
+                     bool left_to_right);
+
+bool chunk_awake(const chunk_t *chunk);
+
+int chunks_awake();
+
+#endif //SAND_CHUNK_H
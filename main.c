@@ -1,83 +1,36 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-#include "shader.h"
+#include "render.h"
+#include "sim.h"
+#include "rng.h"
+#include "runner.h"
+#include "world.h"
 #include "linmath.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
-
-#define W_WIDTH 1920
-#define W_HEIGHT 1080
-#define MAX_PIXELS (1920 * 1080)
-#define VERTEX_ELEMENTS 20
-#define VERTEX_STRIDE 5
-
-typedef struct pixel_t pixel_t;
-
-typedef void (*update_f)(pixel_t *);
-
-typedef enum {
-    SAND, WATER
-} pixel_type_e;
-
-typedef enum {
-    N, E, S, W, NE, NW, SE, SW
-} pixel_direction_e;
-
-typedef struct {
-    float x;
-    float y;
-} pos_t;
-
-typedef struct {
-    float r;
-    float g;
-    float b;
-} rgb_t;
-
-struct pixel_t {
-    pos_t pos;
-    rgb_t rgb;
-    int index;
-    float mass;
-    float friction;
-    float life_time;
-    update_f update;
-    pixel_type_e type;
-    int grid_x;
-    int grid_y;
-};
-
-typedef struct {
-    pos_t pos;
-    rgb_t rgb;
-} pixel_vertex_t;
+#include <string.h>
 
 bool should_close = false;
 bool mouse_left_down = false;
 bool mouse_right_down = false;
+bool mouse_middle_down = false;
 double mouse_x;
 double mouse_y;
+// world cell at the centre of the screen and half the screen height in
+// cells. written on the GL thread and read by pour() on the sim thread.
+double camera_x;
+double camera_y;
 float zoom;
-float *vertex_buffer;
-float gravity;
-float scale;
-int pixel_count;
+// window origin of the snapshot being drawn, see world.h
+int64_t view_origin_x;
+int64_t view_origin_y;
 int w_width, w_height;
-int grid[W_WIDTH * W_HEIGHT];
-pixel_t **pixels;
 mat4x4 mvp;
 
-
-void pixel_add(float x, float y, pixel_type_e type);
-
-float float_rand(float min, float max) {
-    float s = rand() / (float) RAND_MAX; /* [0, 1.0] */
-    return min + s * (max - min);        /* [min, max] */
-}
-
 void window_close_callback(GLFWwindow *w) {
     should_close = true;
 }
@@ -89,7 +42,10 @@ void set_aspect(int width, int height) {
     mat4x4 m, p;
     mat4x4_identity(m);
     mat4x4_ortho(p, -aspect * zoom, aspect * zoom, zoom, -zoom, 1, -1);
-    mat4x4_translate_in_place(p, -aspect * zoom, -zoom, -1);
+    // the grains are drawn in window cells, move the camera into them
+    mat4x4_translate_in_place(p, (float) ((double) view_origin_x - camera_x),
+                              (float) ((double) view_origin_y - camera_y),
+                              -1);
     mat4x4_mul(mvp, p, m);
 }
 
@@ -103,32 +59,50 @@ void error_callback(int error, const char *description) {
     printf("Error: %s\n", description);
 }
 
+// moves the camera by x, y screen pixels
+void camera_pan(double x, double y) {
+    double cells = 2.0 * zoom / w_height;
+    double to_x = camera_x + x * cells;
+    double to_y = camera_y + y * cells;
+    __atomic_store(&camera_x, &to_x, __ATOMIC_RELAXED);
+    __atomic_store(&camera_y, &to_y, __ATOMIC_RELAXED);
+}
+
+// the mouse state is written here on the GL thread and read by pour() on
+// the sim thread
 void cursor_position_callback(GLFWwindow *w, double x_pos,
                               double y_pos) {
-    mouse_x = x_pos;
-    mouse_y = y_pos;
+    if (mouse_middle_down) {
+        // drag the world along with the cursor
+        camera_pan(mouse_x - x_pos, mouse_y - y_pos);
+    }
+    __atomic_store(&mouse_x, &x_pos, __ATOMIC_RELAXED);
+    __atomic_store(&mouse_y, &y_pos, __ATOMIC_RELAXED);
 }
 
 void scroll_callback(GLFWwindow *w, double x_offset, double y_offset) {
-    //    if (y_offset == -1.0f) {
-    //        if (zoom < 100.0f) { zoom += 5.0f; }
-    //    } else {
-    //        if (zoom > 5.0f) { zoom -= 5.0f; }
-    //    }
+    // out to one cell per screen pixel, in to 16
+    float to = y_offset < 0.0 ? zoom * 1.25f : zoom * 0.8f;
+    if (to > W_HEIGHT / 2.0f) { to = W_HEIGHT / 2.0f; }
+    if (to < W_HEIGHT / 32.0f) { to = W_HEIGHT / 32.0f; }
+    __atomic_store(&zoom, &to, __ATOMIC_RELAXED);
 }
 
 void mouse_button_callback(GLFWwindow *w, int button, int action, int mods) {
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
-        mouse_right_down = true;
+        __atomic_store_n(&mouse_right_down, true, __ATOMIC_RELAXED);
     }
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE) {
-        mouse_right_down = false;
+        __atomic_store_n(&mouse_right_down, false, __ATOMIC_RELAXED);
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-        mouse_left_down = true;
+        __atomic_store_n(&mouse_left_down, true, __ATOMIC_RELAXED);
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
-        mouse_left_down = false;
+        __atomic_store_n(&mouse_left_down, false, __ATOMIC_RELAXED);
+    }
+    if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
+        mouse_middle_down = action == GLFW_PRESS;
     }
 }
 
@@ -137,327 +111,185 @@ void keyboard_event(GLFWwindow *w, int key, int scancode, int action,
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         should_close = true;
     }
-}
-
-void ffree(void *obj) {
-    if (obj != NULL) {
-        free(obj);
-        obj = NULL;
-    }
-}
-
-void grid_init() {
-    for (int x = 0; x < W_WIDTH * W_HEIGHT; x++) {
-        grid[x] = -1;
+    if (action == GLFW_RELEASE) {
+        return;
     }
+    // a quarter of the screen height per press
+    double step = w_height / 4.0;
+    if (key == GLFW_KEY_LEFT) { camera_pan(-step, 0.0); }
+    if (key == GLFW_KEY_RIGHT) { camera_pan(step, 0.0); }
+    if (key == GLFW_KEY_UP) { camera_pan(0.0, -step); }
+    if (key == GLFW_KEY_DOWN) { camera_pan(0.0, step); }
 }
 
-void update(pixel_t *pixel) {
-    bool can_move = false;
-    pixel_direction_e dir = S;
-    int pixel_x = pixel->grid_x;
-    int pixel_y = pixel->grid_y;
-    int grid_position = pixel_x + pixel_y * W_WIDTH;
-    int mass = (int) pixel->mass;
-    int friction = (int) pixel->friction;
-    int distance_s = 0;
-    int distance_w = 0;
-    int distance_e = 0;
-    int distance_se = 0;
-    int distance_sw = 0;
-
-    int dir_e;
-    int dir_se;
-    int dir_s;
-    int dir_sw;
-    int dir_w;
-
-    for (int m = 1; m < mass; m++) {
-        dir_s = pixel_x + (pixel_y + m) * W_WIDTH;
-        if (grid[dir_s] != -1) {
-            break;
-        }
-        distance_s++;
-    }
-    for (int m = 1; m < mass; m++) {
-        dir_w = (pixel_x - m) + pixel_y * W_WIDTH;
-        if (grid[dir_w] != -1) {
-            break;
-        }
-        distance_w++;
-    }
-    for (int m = 1; m < mass; m++) {
-        dir_e = (pixel_x + m) + pixel_y * W_WIDTH;
-        if (grid[dir_e] != -1) {
-            break;
-        }
-        distance_e++;
-    }
-    for (int m = 1; m < friction; m++) {
-        dir_sw = (pixel_x - m) + (pixel_y + m) * W_WIDTH;
-        if (grid[dir_sw] != -1) {
-            break;
+// --bench-upload: renders frames of one frozen snapshot with every stream
+// strategy in turn and reports what the uploads cost, so the strategy can
+// be picked per driver
+void bench_upload(GLFWwindow *window, render_mode_e render, int frames) {
+    // a full world without the mouse
+    brush_t brush;
+    brush.shape = BRUSH_RECT;
+    brush.x = W_WIDTH / 2;
+    brush.y = W_HEIGHT / 2;
+    brush.radius = W_WIDTH / 2;
+    brush.density = 0.5f;
+    brush.material = SAND;
+    pixel_add_batch(&brush);
+    brush.material = WATER;
+    brush.density = 0.1f;
+    pixel_add_batch(&brush);
+
+    // a strategy may need the instanced fallback, publish for every mode
+    // the loop below ends up drawing
+    int contents = 0;
+    for (int s = 0; s < STREAM_STRATEGIES; s++) {
+        contents |= render_snapshot_contents(
+                render_mode_supported(render, (stream_strategy_e) s));
+    }
+    runner_start(NULL, contents);
+    const snapshot_t *snapshot = runner_acquire();
+    while (snapshot->pixels == 0) {
+        glfwWaitEventsTimeout(0.01);
+        snapshot = runner_acquire();
+    }
+    // runner_stop() frees the snapshots, keep a copy of this one
+    snapshot_t frame = *snapshot;
+    // every frame uploads the cells in full, this measures the strategies,
+    // not what changed in one tick. the colours only go up once, as they do
+    // while nothing spawns.
+    frame.span_count = -1;
+    size_t vertices = frame.quads * sizeof(pixel_vertex_t);
+    size_t colours = frame.quads * sizeof(pixel_colour_t);
+    size_t instances = frame.instance_count * sizeof(pixel_instance_t);
+    frame.vertices = malloc(vertices + 1);
+    frame.colours = malloc(colours + 1);
+    frame.instances = malloc(instances + 1);
+    frame.materials = malloc(W_WIDTH * W_HEIGHT);
+    checkm(frame.vertices);
+    checkm(frame.colours);
+    checkm(frame.instances);
+    checkm(frame.materials);
+    if (vertices > 0) {
+        memcpy(frame.vertices, snapshot->vertices, vertices);
+        memcpy(frame.colours, snapshot->colours, colours);
+    }
+    if (instances > 0) {
+        memcpy(frame.instances, snapshot->instances, instances);
+    }
+    if (snapshot->materials) {
+        memcpy(frame.materials, snapshot->materials, W_WIDTH * W_HEIGHT);
+    }
+    runner_stop();
+    printf("upload bench: %d pixels, %d frames\n", frame.pixels, frames);
+
+    for (int s = 0; s < STREAM_STRATEGIES; s++) {
+        render_init(render, (stream_strategy_e) s);
+        glFinish();
+        double start = glfwGetTime();
+        frame.colour_span_count = -1;
+        for (int f = 0; f < frames; f++) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            // a new tick every frame so the texture mode uploads too
+            frame.tick++;
+            render_frame(&frame, mvp, scale);
+            frame.colour_span_count = 0;
+            glfwSwapBuffers(window);
+            glfwPollEvents();
         }
-        distance_sw++;
-    }
-    for (int m = 1; m < friction; m++) {
-        dir_se = (pixel_x + m) + (pixel_y + m) * W_WIDTH;
-        if (grid[dir_se] != -1) {
-            break;
-        }
-        distance_se++;
-    }
-
-    dir_s = (pixel_x) + (pixel_y + 1) * W_WIDTH;
-    dir_sw = (pixel_x - 1) + (pixel_y + 1) * W_WIDTH;
-    dir_se = (pixel_x + 1) + (pixel_y + 1) * W_WIDTH;
-    dir_w = (pixel_x - 1) + pixel_y * W_WIDTH;
-    dir_e = (pixel_x + 1) + pixel_y * W_WIDTH;
-
-    switch (pixel->type) {
-        case SAND:
-            if (grid[dir_s] == -1) {
-                can_move = true;
-                dir = S;
-            } else if (grid[dir_sw] == -1) {
-                can_move = true;
-                dir = SW;
-            } else if (grid[dir_se] == -1) {
-                can_move = true;
-                dir = SE;
-            }
-            break;
-        case WATER:
-            if (grid[dir_s] == -1) {
-                can_move = true;
-                dir = S;
-            } else if (grid[dir_sw] == -1) {
-                can_move = true;
-                dir = SW;
-            } else if (grid[dir_se] == -1) {
-                can_move = true;
-                dir = SE;
-            } else if (grid[dir_w] == -1) {
-                can_move = true;
-                dir = W;
-            } else if (grid[dir_e] == -1) {
-                can_move = true;
-                dir = E;
-            }
-            break;
-    }
-
-    if (!can_move) {
-        return;
-    }
-
-    switch (dir) {
-        case S:
-            pixel->pos.y += scale * (float) distance_s;
-            pixel->grid_y += (int) (scale * (float) distance_s);
-            break;
-        case W:
-            pixel->pos.x -= scale * (float) distance_w;
-            pixel->grid_x -= (int) (scale * (float) distance_w);
-            break;
-        case E:
-            pixel->pos.x += scale * (float) distance_e;
-            pixel->grid_x += (int) (scale * (float) distance_e);
-            break;
-        case SW:
-            pixel->pos.x -= scale * (float) distance_sw;
-            pixel->pos.y += scale * (float) distance_sw;
-            pixel->grid_x -= (int) (scale * (float) distance_sw);
-            pixel->grid_y += (int) (scale * (float) distance_sw);
-            break;
-        case SE:
-            pixel->pos.x += scale * (float) distance_se;
-            pixel->pos.y += scale * (float) distance_se;
-            pixel->grid_x += (int) (scale * (float) distance_se);
-            pixel->grid_y += (int) (scale * (float) distance_se);
-            break;
-        default:
-            break;
-    }
-
-    if (pixel->pos.y >= W_HEIGHT - 1) {
-        pixel->pos.y = W_HEIGHT - 1;
-        pixel->grid_y = W_HEIGHT - 1;
-    }
-    if (pixel->pos.x >= W_WIDTH - 1) {
-        pixel->pos.x = W_WIDTH - 1;
-        pixel->grid_x = W_WIDTH - 1;
-    }
-
-    pixel_x = (int) pixel->grid_x;
-    pixel_y = (int) pixel->grid_y;
-    int new_position = pixel_x + pixel_y * W_WIDTH;
-    grid[new_position] = pixel->index;
-    grid[grid_position] = -1;
-
-    float v[8];
-    v[0] = pixel->pos.x - scale;
-    v[1] = pixel->pos.y - scale;
-    v[2] = pixel->pos.x + scale;
-    v[3] = pixel->pos.y - scale;
-    v[4] = pixel->pos.x + scale;
-    v[5] = pixel->pos.y + scale;
-    v[6] = pixel->pos.x - scale;
-    v[7] = pixel->pos.y + scale;
-
-    int cnt = 0;
-    int position_size = 2;
-    int offset = pixel->index * VERTEX_ELEMENTS;
-    for (int y = 0; y < VERTEX_ELEMENTS; y += VERTEX_STRIDE) {
-        float m[position_size];
-        for (int x = 0; x < position_size; x++) { m[x] = v[cnt + x]; }
-        memcpy(vertex_buffer + offset + y, m, position_size * sizeof(float));
-        cnt += position_size;
-    }
+        glFinish();
+        double elapsed = glfwGetTime() - start;
+        printf("%-10s upload: %.3f ms/frame, %.1f KB/frame, frame: %.3f ms\n",
+               stream_strategy_name((stream_strategy_e) s),
+               render_upload_seconds() * 1000.0 / frames,
+               (double) render_upload_bytes() / 1024.0 / frames,
+               elapsed * 1000.0 / frames);
+        render_terminate();
+    }
+    free(frame.vertices);
+    free(frame.colours);
+    free(frame.instances);
+    free(frame.materials);
 }
 
-void checkm(void *obj) {
-    if (obj == NULL) {
-        printf("Could not allocate memory for object\n");
-        exit(-1);
+// runs on the sim thread before every tick, keeps the window under the
+// camera and pours where the mouse points
+void pour() {
+    double x, y, view_x, view_y;
+    float view_zoom;
+    __atomic_load(&mouse_x, &x, __ATOMIC_RELAXED);
+    __atomic_load(&mouse_y, &y, __ATOMIC_RELAXED);
+    __atomic_load(&camera_x, &view_x, __ATOMIC_RELAXED);
+    __atomic_load(&camera_y, &view_y, __ATOMIC_RELAXED);
+    __atomic_load(&zoom, &view_zoom, __ATOMIC_RELAXED);
+    world_follow(view_x, view_y);
+
+    // screen pixels to window cells
+    double cells = 2.0 * view_zoom / w_height;
+    brush_t brush;
+    brush.shape = BRUSH_RECT;
+    brush.x = (int) floor(view_x - (double) world_origin_x +
+                          (x - w_width / 2.0) * cells);
+    brush.y = (int) floor(view_y - (double) world_origin_y +
+                          (y - w_height / 2.0) * cells);
+    brush.radius = 50;
+    if (__atomic_load_n(&mouse_left_down, __ATOMIC_RELAXED)) {
+        brush.density = 0.05f;
+        brush.material = SAND;
+        pixel_add_batch(&brush);
+    }
+    if (__atomic_load_n(&mouse_right_down, __ATOMIC_RELAXED)) {
+        brush.density = 0.005f;
+        brush.material = WATER;
+        pixel_add_batch(&brush);
     }
 }
 
-void repack() {
-    return; // not used for now
-    float *pixel_buffer = malloc(pixel_count * VERTEX_ELEMENTS * sizeof(float));
-    for (int i = 0; i < MAX_PIXELS; i++) {
-        if (pixels[i]->index != -1) {
-            int offset = pixels[i]->index * VERTEX_ELEMENTS;
-            memcpy(pixel_buffer + (i * VERTEX_ELEMENTS), vertex_buffer + offset,
-                   VERTEX_ELEMENTS * sizeof(float));
+int main(int argc, char **argv) {
+    int workers = 1;
+    bool vsync = true;
+    render_mode_e render = RENDER_QUADS;
+    stream_strategy_e stream = STREAM_SUBDATA;
+    int bench_frames = 0;
+    const char *world_store = "sand.world";
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--workers") == 0 && a + 1 < argc) {
+            workers = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            rng_global_seed = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--engine") == 0 && a + 1 < argc) {
+            a++;
+            sim_engine = strcmp(argv[a], "cells") == 0 ? ENGINE_CELLS
+                                                       : ENGINE_PARTICLES;
+        } else if (strcmp(argv[a], "--tick-rate") == 0 && a + 1 < argc) {
+            sim_tick_rate = atof(argv[++a]);
+        } else if (strcmp(argv[a], "--max-ticks") == 0 && a + 1 < argc) {
+            sim_max_ticks = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--render") == 0 && a + 1 < argc) {
+            render = render_mode_parse(argv[++a]);
+        } else if (strcmp(argv[a], "--stream") == 0 && a + 1 < argc) {
+            stream = stream_strategy_parse(argv[++a]);
+        } else if (strcmp(argv[a], "--bench-upload") == 0 && a + 1 < argc) {
+            bench_frames = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--world") == 0 && a + 1 < argc) {
+            world_store = argv[++a];
+        } else if (strcmp(argv[a], "--no-vsync") == 0) {
+            vsync = false;
         }
     }
-    memcpy(vertex_buffer, pixel_buffer,
-           pixel_count * VERTEX_ELEMENTS * sizeof(float));
-    ffree(pixel_buffer);
-}
-
-void pixel_add(float x, float y, pixel_type_e type) {
-    if (pixel_count >= MAX_PIXELS - 10) {
-        return;
-    }
-    //    int i;
-    //    for (i = 0; i < MAX_PIXELS; i++) {
-    //        if (pixels[i]->index == -1) { break; }
-    //    }
-    int i = pixel_count;
-
-    if (x < 1) {
-        x = 1;
-    }
-    if (x > W_WIDTH) {
-        x = W_WIDTH;
-    }
-    if (y < 1) {
-        y = 1;
-    }
-    if (y > W_HEIGHT - 1) {
-        y = W_HEIGHT - 1;
-    }
-
-    pos_t pos;
-    pos.x = x;
-    pos.y = y;
-
-    rgb_t rgb;
-
-    switch (type) {
-        case SAND:
-            rgb.r = 1.0f;
-            rgb.g = 0.89f;
-            rgb.b = 0.623f;
-            break;
-        case WATER:
-            rgb.r = 0.0f;
-            rgb.g = 0.1f;
-            rgb.b = 1.0f;
-        default:
-            break;
-    }
-
-    pixels[i]->index = i;
-    pixels[i]->pos = pos;
-    pixels[i]->rgb = rgb;
-    pixels[i]->type = type;
-    pixels[i]->mass = 1.0f;
-    pixels[i]->life_time = 0;
-    pixels[i]->grid_x = (int) x;
-    pixels[i]->grid_y = (int) y;
-
-    switch (type) {
-        case SAND:
-            pixels[i]->mass = 15;
-            pixels[i]->friction = 2.0f;
-            break;
-        case WATER:
-            pixels[i]->mass = 15;
-            pixels[i]->friction = 1.0f;
-            break;
-        default:
-            pixels[i]->mass = 1.0f;
-            pixels[i]->friction = 1.0f;
-            break;
-    }
-
-    pixel_vertex_t p[4];
-    x += scale;
-    y += scale;
-    // ll
-    p[0].pos.x = x - scale;
-    p[0].pos.y = y - scale;
-    // lr
-    p[1].pos.x = x + scale;
-    p[1].pos.y = y - scale;
-    // ul
-    p[2].pos.x = x + scale;
-    p[2].pos.y = y + scale;
-    // ul
-    p[3].pos.x = x - scale;
-    p[3].pos.y = y + scale;
-    // color
-    for (int n = 0; n < 4; n++) {
-        p[n].rgb.r = rgb.r;
-        p[n].rgb.g = rgb.g;
-        p[n].rgb.b = rgb.b;
-    }
-
-    int offset = i * VERTEX_ELEMENTS;
-    memcpy(vertex_buffer + offset, p, VERTEX_ELEMENTS * sizeof(float));
-    int pixel_x = pixels[i]->grid_x;
-    int pixel_y = pixels[i]->grid_y;
-    int grid_position = pixel_x + pixel_y * W_WIDTH;
-    grid[grid_position] = i;
-    pixel_count++;
-    repack();
-}
-
-void pixel_destroy(pixel_t *pixel) {
-    if (pixel == NULL || pixel->index == -1) {
-        return;
+    if (sim_tick_rate <= 0.0) {
+        printf("--tick-rate must be positive\n");
+        return -1;
     }
-    pixel->index = -1;
-    int x = pixel->grid_x;
-    int y = pixel->grid_y;
-    int grid_position = x + y * W_WIDTH;
-    grid[grid_position] = -1;
-    pixel_count--;
-    repack();
-}
 
-int main() {
-    pixel_count = 0;
-    zoom = 540.0f;
-    scale = 1.0f;
-    gravity = 1.0f;
+    // one cell per pixel, looking at the window at the world origin
+    zoom = W_HEIGHT / 2.0f;
+    camera_x = W_WIDTH / 2.0;
+    camera_y = W_HEIGHT / 2.0;
     w_width = W_WIDTH;
     w_height = W_HEIGHT;
-    grid_init();
+    sim_init();
+    sim_set_workers(workers);
+    world_init(world_store);
 
     if (!glfwInit()) {
         printf("Could not initialize GLFW\n");
@@ -487,143 +319,66 @@ int main() {
     glfwSetWindowCloseCallback(window, window_close_callback);
     glfwSetFramebufferSizeCallback(window, resize_callback);
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);// v-sync
+    glfwSwapInterval(vsync ? 1 : 0);// v-sync
     glewExperimental = GL_TRUE;
     glewInit();
     glDisable(GL_DEPTH_TEST);
     set_aspect(w_width, w_height);
-    // shader
-    char *vs = "#version 330 core\n"
-               "layout (location = 0) in vec2 in_Position;\n"
-               "layout (location = 1) in vec3 in_Color;\n"
-               "uniform mat4 mvp;\n"
-               "out vec3 vertexColor;\n"
-               "void main()\n"
-               "{\n"
-               "    gl_Position = mvp * vec4(in_Position, 0.0f, 1.0f);\n"
-               "    vertexColor = in_Color;\n"
-               "}\n\0";
-    char *fs = "#version 330 core\n"
-               "out vec4 FragColor;\n"
-               "in vec3 vertexColor;\n"
-               "void main()\n"
-               "{\n"
-               "    FragColor = vec4(vertexColor, 1.0f);\n"
-               "}\n\0";
-    GLuint program = shader_program_create_s(vs, fs);
-    shader_program_bind_attribute_location(program, 0, "in_Position");
-    shader_program_bind_attribute_location(program, 1, "in_Color");
-    shader_program_link(program);
-    GLint mvp_uniform = shader_program_get_uniform_location(program, "mvp");
-    // gl
-    GLuint vao, vbo, ebo = 0;
-    uint32_t *element_buffer;
-    // vao
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    // vbo
-    vertex_buffer = malloc(MAX_PIXELS * sizeof(float) * VERTEX_ELEMENTS);
-    checkm(vertex_buffer);
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 MAX_PIXELS * sizeof(float) * VERTEX_ELEMENTS,
-                 NULL, GL_DYNAMIC_DRAW);
-    // ebo
-    element_buffer = malloc(MAX_PIXELS * sizeof(uint32_t) * 6);
-    checkm(element_buffer);
-    int p = 0;
-    for (int e = 0; e < MAX_PIXELS - 6; e += 6) {
-        element_buffer[e] = 0 + p;
-        element_buffer[e + 1] = 1 + p;
-        element_buffer[e + 2] = 2 + p;
-        element_buffer[e + 3] = 2 + p;
-        element_buffer[e + 4] = 3 + p;
-        element_buffer[e + 5] = 0 + p;
-        p += 4;
-    }
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MAX_PIXELS * sizeof(uint32_t),
-                 element_buffer, GL_STATIC_DRAW);
-    // position attribute pointer
-    GLuint position_size = 2;
-    glVertexAttribPointer(0, position_size, GL_FLOAT, GL_FALSE,
-                          VERTEX_STRIDE * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);
-    // rgb attribute pointer
-    GLuint rgb_size = 3;
-    glVertexAttribPointer(1, rgb_size, GL_FLOAT, GL_FALSE,
-                          VERTEX_STRIDE * sizeof(float),
-                          (void *) (position_size * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // pixels
-    pixels = malloc(MAX_PIXELS * sizeof(pixel_t *));
-    checkm(pixels);
-    for (int x = 0; x < MAX_PIXELS; x++) {
-        pixels[x] = malloc(sizeof(pixel_t));
-        checkm(pixels[x]);
-        pixels[x]->index = -1;
-        pixels[x]->update = update;
+    if (bench_frames > 0) {
+        bench_upload(window, render, bench_frames);
+        glfwTerminate();
+        world_terminate();
+        sim_terminate();
+        return 0;
     }
+    // the runner has to publish what the mode actually drawn reads
+    render = render_mode_supported(render, stream);
+    render_init(render, stream);
 
     // game loop
     double delta;
     double start_time;
     double previous_time = glfwGetTime();
     int frame_count = 0;
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    unsigned int tick_count = sim_tick;
+    size_t upload_bytes = 0;
+    runner_start(pour, render_snapshot_contents(render));
 
     while (!should_close) {
         start_time = glfwGetTime();
         glClear(GL_COLOR_BUFFER_BIT);
         glClearColor(0.169f, 0.169f, 0.169f, 1.0f);
-        glUseProgram(program);
-        glUniformMatrix4fv(mvp_uniform, 1, GL_FALSE, (const GLfloat *) mvp);
-        set_aspect(w_width, w_height);
-
-        if (mouse_left_down) {
-            float min = -50.0f;
-            float max = 50.0f;
-            for (int x = 0; x < 500; x++) {
-                pixel_add((float) mouse_x + float_rand(min, max),
-                          (float) mouse_y + float_rand(min, max), SAND);
-            }
-        }
-        if (mouse_right_down) {
-            float min = -50.0f;
-            float max = 50.0f;
-            for (int x = 0; x < 50; x++) {
-                pixel_add((float) mouse_x + float_rand(min, max),
-                          (float) mouse_y + float_rand(min, max), WATER);
-            }
-        }
 
-        for (int x = 0; x < pixel_count; x++) {
-            if (pixels[x]->index != -1) {
-                pixels[x]->update(pixels[x]);
-            }
-        }
-
-        glBufferSubData(GL_ARRAY_BUFFER, 0,
-                        pixel_count * sizeof(float) * VERTEX_ELEMENTS,
-                        vertex_buffer);
-        glDrawElements(GL_TRIANGLES, pixel_count * 6, GL_UNSIGNED_INT, 0);
+        // the sim thread steps at sim_tick_rate on its own, a frame draws
+        // whatever it finished last
+        const snapshot_t *snapshot = runner_acquire();
+        view_origin_x = snapshot->origin_x;
+        view_origin_y = snapshot->origin_y;
+        set_aspect(w_width, w_height);
+        render_frame(snapshot, mvp, scale);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
         delta = glfwGetTime() - start_time;
         frame_count++;
         if (start_time - previous_time >= 1.0) {
-            printf("frame: %.2f, fps: %d, pixels: %d/%d, mouse: %f, %f\n",
-                   delta * 1000, frame_count, pixel_count, MAX_PIXELS, mouse_x,
-                   mouse_y);
+            printf("frame: %.2f, fps: %d, tps: %u, pixels: %d/%d, "
+                   "upload: %.1f KB/frame, mouse: %f, %f\n", delta * 1000,
+                   frame_count, snapshot->tick - tick_count, snapshot->pixels,
+                   MAX_PIXELS, (double) (render_upload_bytes() -
+                                         upload_bytes) / 1024.0 / frame_count,
+                   mouse_x, mouse_y);
+            upload_bytes = render_upload_bytes();
             previous_time = start_time;
             frame_count = 0;
+            tick_count = snapshot->tick;
         }
     }
 
+    runner_stop();
+    render_terminate();
     glfwTerminate();
+    world_terminate();
+    sim_terminate();
     return 0;
 }
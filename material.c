@@ -0,0 +1,12 @@
+//
+// Created by dbrent on 4/16/21.
+//
+
+#include "material.h"
+
+#define MATERIAL_ROW(name, r, g, b, density, fall, spread, friction, moves) \
+        {#name, {r, g, b}, density, fall, spread, friction, moves},
+
+const material_t material_table[PIXEL_TYPES] = {
+        MATERIALS(MATERIAL_ROW)
+};
@@ -0,0 +1,70 @@
+//
+// Created by dbrent on 4/16/21.
+//
+
+#ifndef SAND_MATERIAL_H
+#define SAND_MATERIAL_H
+
+#include "particles.h"
+
+// directions a material may move in. update() tries them in this order:
+// down, sinking, down-left then down-right, left then right.
+typedef enum {
+    MOVE_DOWN = 1 << 0,
+    MOVE_DIAGONAL = 1 << 1,
+    MOVE_SIDEWAYS = 1 << 2,
+    // trades places with a lighter grain right below it
+    MOVE_SINK = 1 << 3
+} move_rule_e;
+
+// every material, one row each:
+// X(name, r, g, b, density, fall, spread, friction, moves)
+//   density  MOVE_SINK materials sink through ones of lower density
+//   fall     most cells a grain drops in one tick
+//   spread   most cells it flows sideways in one tick
+//   friction most cells it slides diagonally in one tick, 1 or less still
+//            moves it one cell
+//   moves    move_rule_e bits
+// a new material is a new row here, the enum, the table and a specialised
+// update kernel are all generated from it. the limits below and in cell.h
+// and chunk.h are checked at compile time.
+#define MATERIALS(X) \
+        X(SAND, 255, 227, 159, 2, 15, 0, 2, \
+          MOVE_DOWN | MOVE_SINK | MOVE_DIAGONAL) \
+        X(WATER, 0, 26, 255, 1, 15, 15, 1, \
+          MOVE_DOWN | MOVE_DIAGONAL | MOVE_SIDEWAYS)
+
+#define MATERIAL_ENUM(name, r, g, b, density, fall, spread, friction, \
+                      moves) name,
+
+typedef enum {
+    MATERIALS(MATERIAL_ENUM)
+    PIXEL_TYPES
+} pixel_type_e;
+
+// most cells a grain may fall, spread or slide in one tick. the cell
+// engine's scans assume it, and chunk.h keeps it well inside a chunk.
+#define MATERIAL_REACH 15
+
+#define MATERIAL_CHECK(name, r, g, b, density, fall, spread, friction, \
+                       moves) \
+        _Static_assert(fall <= MATERIAL_REACH && spread <= MATERIAL_REACH && \
+                       friction <= MATERIAL_REACH, \
+                       #name " reaches further than MATERIAL_REACH");
+
+MATERIALS(MATERIAL_CHECK)
+
+typedef struct {
+    const char *name;
+    rgb_t rgb;
+    int density;
+    int fall;
+    int spread;
+    int friction;
+    int moves;
+} material_t;
+
+// indexed by pixel_type_e
+extern const material_t material_table[PIXEL_TYPES];
+
+#endif //SAND_MATERIAL_H
@@ -0,0 +1,78 @@
+//
+// Created by dbrent on 3/25/21.
+//
+
+#include "occupancy.h"
+
+uint64_t occupancy[W_HEIGHT * OCCUPANCY_WORDS];
+
+void occupancy_clear() {
+    int padding = OCCUPANCY_WORDS * 64 - W_WIDTH;
+    uint64_t last = padding ? ~(uint64_t) 0 << (64 - padding) : 0;
+    for (int y = 0; y < W_HEIGHT; y++) {
+        for (int w = 0; w < OCCUPANCY_WORDS; w++) {
+            occupancy[y * OCCUPANCY_WORDS + w] = 0;
+        }
+        occupancy[y * OCCUPANCY_WORDS + OCCUPANCY_WORDS - 1] = last;
+    }
+}
+
+int occupancy_free_east(int x, int y, int limit) {
+    int start = x + 1;
+    int word = y * OCCUPANCY_WORDS + (start >> 6);
+    int end = (y + 1) * OCCUPANCY_WORDS;
+    int distance = 0;
+    // bits above the start cell, the lowest set bit is the first obstacle
+    uint64_t bits = start < W_WIDTH ? occupancy_word(word) >> (start & 63)
+                                    : 1;
+    int available = 64 - (start & 63);
+    while (distance < limit) {
+        if (bits) {
+            distance += __builtin_ctzll(bits);
+            break;
+        }
+        distance += available;
+        if (++word >= end) {
+            break;
+        }
+        bits = occupancy_word(word);
+        available = 64;
+    }
+    return distance < limit ? distance : limit;
+}
+
+int occupancy_free_west(int x, int y, int limit) {
+    int start = x - 1;
+    if (start < 0) {
+        return 0;
+    }
+    int word = y * OCCUPANCY_WORDS + (start >> 6);
+    int begin = y * OCCUPANCY_WORDS;
+    int distance = 0;
+    // bits below and including the start cell, moved to the top of the word
+    // so the highest set bit is the first obstacle
+    uint64_t bits = occupancy_word(word) << (63 - (start & 63));
+    int available = (start & 63) + 1;
+    while (distance < limit) {
+        if (bits) {
+            distance += __builtin_clzll(bits);
+            break;
+        }
+        distance += available;
+        if (--word < begin) {
+            break;
+        }
+        bits = occupancy_word(word);
+        available = 64;
+    }
+    return distance < limit ? distance : limit;
+}
+
+int occupancy_free_down(int x, int y, int step_x, int limit) {
+    int distance = 0;
+    while (distance < limit &&
+           !occupancy_test(x + (distance + 1) * step_x, y + distance + 1)) {
+        distance++;
+    }
+    return distance;
+}
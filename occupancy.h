@@ -0,0 +1,56 @@
+//
+// Created by dbrent on 3/25/21.
+//
+
+#ifndef SAND_OCCUPANCY_H
+#define SAND_OCCUPANCY_H
+
+#include "sim.h"
+
+#include <stdint.h>
+
+// one bit per grid cell, set when the cell holds a particle. rows are padded
+// to whole 64-bit words and the padding bits read as occupied, so a run
+// stops at the edge of the world on its own. the whole map is ~260 KB and
+// stays in L2 while update() probes it.
+#define OCCUPANCY_WORDS ((W_WIDTH + 63) / 64)
+
+extern uint64_t occupancy[W_HEIGHT * OCCUPANCY_WORDS];
+
+// chunks stepped in parallel can own different bits of the same word, so
+// writers use atomic read-modify-writes. readers only ever look at bits no
+// other chunk writes, a relaxed load is enough.
+static inline uint64_t occupancy_word(int word) {
+    return __atomic_load_n(&occupancy[word], __ATOMIC_RELAXED);
+}
+
+static inline bool occupancy_test(int x, int y) {
+    if (x < 0 || x >= W_WIDTH || y < 0 || y >= W_HEIGHT) {
+        return true;
+    }
+    return occupancy_word(y * OCCUPANCY_WORDS + (x >> 6)) >> (x & 63) & 1;
+}
+
+static inline void occupancy_set(int x, int y) {
+    __atomic_fetch_or(&occupancy[y * OCCUPANCY_WORDS + (x >> 6)],
+                      (uint64_t) 1 << (x & 63), __ATOMIC_RELAXED);
+}
+
+static inline void occupancy_reset(int x, int y) {
+    __atomic_fetch_and(&occupancy[y * OCCUPANCY_WORDS + (x >> 6)],
+                       ~((uint64_t) 1 << (x & 63)), __ATOMIC_RELAXED);
+}
+
+void occupancy_clear();
+
+// number of free cells directly east (x + 1 ...) / west (x - 1 ...) of
+// x, y, at most limit
+int occupancy_free_east(int x, int y, int limit);
+
+int occupancy_free_west(int x, int y, int limit);
+
+// number of free cells stepping step_x, +1 row at a time from x, y, at most
+// limit. used for the south and diagonal probes.
+int occupancy_free_down(int x, int y, int step_x, int limit);
+
+#endif //SAND_OCCUPANCY_H
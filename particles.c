@@ -0,0 +1,53 @@
+//
+// Created by dbrent on 3/12/21.
+//
+
+#include "particles.h"
+#include "sim.h"
+
+#include <stdlib.h>
+
+particles_t particles;
+
+void particles_init(int capacity) {
+    particles.capacity = capacity;
+    particles.grid_x = malloc(capacity * sizeof(int));
+    checkm(particles.grid_x);
+    particles.grid_y = malloc(capacity * sizeof(int));
+    checkm(particles.grid_y);
+    particles.type = malloc(capacity * sizeof(uint8_t));
+    checkm(particles.type);
+    particles.flags = calloc(capacity, sizeof(uint8_t));
+    checkm(particles.flags);
+    particles.tick = calloc(capacity, sizeof(unsigned int));
+    checkm(particles.tick);
+    particles.idle = calloc(capacity, sizeof(uint8_t));
+    checkm(particles.idle);
+    particles.vx = calloc(capacity, sizeof(float));
+    checkm(particles.vx);
+    particles.vy = calloc(capacity, sizeof(float));
+    checkm(particles.vy);
+}
+
+void particles_copy(int to, int from) {
+    particles.grid_x[to] = particles.grid_x[from];
+    particles.grid_y[to] = particles.grid_y[from];
+    particles.type[to] = particles.type[from];
+    particles.flags[to] = particles.flags[from];
+    particles.tick[to] = particles.tick[from];
+    particles.idle[to] = particles.idle[from];
+    particles.vx[to] = particles.vx[from];
+    particles.vy[to] = particles.vy[from];
+}
+
+void particles_terminate() {
+    ffree(particles.grid_x);
+    ffree(particles.grid_y);
+    ffree(particles.type);
+    ffree(particles.flags);
+    ffree(particles.tick);
+    ffree(particles.idle);
+    ffree(particles.vx);
+    ffree(particles.vy);
+    particles = (particles_t) {0};
+}
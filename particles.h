@@ -0,0 +1,62 @@
+//
+// Created by dbrent on 3/12/21.
+//
+
+#ifndef SAND_PARTICLES_H
+#define SAND_PARTICLES_H
+
+#include <stdint.h>
+
+typedef enum {
+    PARTICLE_ALIVE = 1 << 0,
+    // skipped by the step until something in its 3x3 neighbourhood changes
+    PARTICLE_ASLEEP = 1 << 1,
+    // its cell changed since the last sim_dirty_spans() for this flag
+    PARTICLE_DIRTY = 1 << 2,
+    // its colour changed, which only happens on spawn and repack
+    PARTICLE_RECOLOURED = 1 << 3
+} particle_flag_e;
+
+// a grain that failed to move is retried after 1, 2, 4 ... ticks and goes
+// to sleep after this many failures in a row
+#define PARTICLE_SLEEP_AFTER 4
+
+// 0..255 per channel. reaches the shaders as a texel of the RGBA8 colour
+// buffer texture (quads) or as a palette entry scaled to 0..1 (instanced,
+// texture).
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} rgb_t;
+
+// struct-of-arrays particle store. every array is indexed by particle index
+// and allocated once, so the update loop reads the hot arrays without
+// chasing a pointer per grain.
+typedef struct {
+    int capacity;
+    // hot: read on every update
+    int *grid_x;
+    int *grid_y;
+    // pixel_type_e, the rules and colour come from material_table[type]
+    uint8_t *type;
+    uint8_t *flags;
+    unsigned int *tick;
+    // failed moves in a row, reset whenever the neighbourhood changes
+    uint8_t *idle;
+    // cells per tick while falling, gravity adds to vy every tick in the
+    // air and landing zeroes both
+    float *vx;
+    float *vy;
+} particles_t;
+
+extern particles_t particles;
+
+void particles_init(int capacity);
+
+// copies every field of particle from into slot to
+void particles_copy(int to, int from);
+
+void particles_terminate();
+
+#endif //SAND_PARTICLES_H
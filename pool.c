@@ -0,0 +1,121 @@
+//
+// Created by dbrent on 3/15/21.
+//
+
+#include "pool.h"
+#include "sim.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static pthread_t *threads;
+static int thread_count;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int generation;
+static unsigned int spawn_generation;
+static bool stopping;
+static int busy;
+
+static pool_job_f job;
+static void *job_arg;
+static int job_count;
+static atomic_int next_item;
+
+static void drain() {
+    int item;
+    while ((item = atomic_fetch_add(&next_item, 1)) < job_count) {
+        job(item, job_arg);
+    }
+}
+
+static void *worker(void *unused) {
+    // pool_run() can't race pool_init(), so this is the generation every
+    // worker starts from even if it is scheduled late
+    unsigned int seen = spawn_generation;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (generation == seen && !stopping) {
+            pthread_cond_wait(&start_cond, &lock);
+        }
+        if (stopping) {
+            break;
+        }
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+        drain();
+        pthread_mutex_lock(&lock);
+        if (--busy == 0) {
+            pthread_cond_signal(&done_cond);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+void pool_init(int workers) {
+    pool_terminate();
+    thread_count = workers > 1 ? workers - 1 : 0;
+    if (thread_count == 0) {
+        return;
+    }
+    stopping = false;
+    spawn_generation = generation;
+    threads = malloc(thread_count * sizeof(pthread_t));
+    checkm(threads);
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+            printf("Could not start worker thread\n");
+            exit(-1);
+        }
+    }
+}
+
+void pool_run(pool_job_f f, void *arg, int count) {
+    if (thread_count == 0 || count <= 1) {
+        for (int i = 0; i < count; i++) {
+            f(i, arg);
+        }
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    job = f;
+    job_arg = arg;
+    job_count = count;
+    atomic_store(&next_item, 0);
+    busy = thread_count;
+    generation++;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&lock);
+
+    drain();
+
+    pthread_mutex_lock(&lock);
+    while (busy > 0) {
+        pthread_cond_wait(&done_cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+int pool_workers() {
+    return thread_count + 1;
+}
+
+void pool_terminate() {
+    if (thread_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    ffree(threads);
+    threads = NULL;
+    thread_count = 0;
+}
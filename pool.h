@@ -0,0 +1,22 @@
+//
+// Created by dbrent on 3/15/21.
+//
+
+#ifndef SAND_POOL_H
+#define SAND_POOL_H
+
+typedef void (*pool_job_f)(int item, void *arg);
+
+// starts workers - 1 threads; the thread calling pool_run() is the last
+// worker. workers <= 1 runs every job inline.
+void pool_init(int workers);
+
+// calls job(item, arg) for every item in 0..count - 1 spread across the
+// workers and returns once all of them have finished
+void pool_run(pool_job_f job, void *arg, int count);
+
+int pool_workers();
+
+void pool_terminate();
+
+#endif //SAND_POOL_H
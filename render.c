@@ -0,0 +1,415 @@
+//
+// Created by dbrent on 4/9/21.
+//
+
+#include "render.h"
+#include "shader.h"
+#include "stream.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static render_mode_e render_mode;
+static GLuint program;
+static GLuint vao;
+static stream_strategy_e render_strategy;
+// vertices, instances or, through a pixel unpack buffer, the texture
+static stream_t stream;
+// the colours of the quads, uploaded when grains spawn or repack
+static stream_t colour_stream;
+// buffer textures over the two quad streams
+static GLuint cell_texture;
+static GLuint colour_texture;
+static GLint first_uniform;
+static GLint colour_first_uniform;
+static double upload_seconds;
+static GLuint texture;
+static GLint mvp_uniform;
+static GLint scale_uniform;
+static GLint inverse_mvp_uniform;
+// the buffer or texture already holds this snapshot, a frame drawn faster
+// than the sim ticks doesn't upload it again
+static const snapshot_t *uploaded;
+static unsigned int uploaded_tick;
+static size_t uploaded_offset;
+static size_t uploaded_colour_offset;
+
+// no vertex attributes and no element buffer: six vertices per quad, quad
+// gl_VertexID / 6 fetches its cell and colour from buffer textures starting
+// at record first, the rest picks the corner of the triangles 0 1 2, 2 3 0
+static char *quads_vs =
+        "#version 330 core\n"
+        "uniform usamplerBuffer cells;\n"
+        "uniform samplerBuffer colours;\n"
+        "uniform int first;\n"
+        "uniform int colour_first;\n"
+        "uniform mat4 mvp;\n"
+        "uniform float scale;\n"
+        "out vec3 vertexColor;\n"
+        "void main()\n"
+        "{\n"
+        "    int quad = gl_VertexID / 6;\n"
+        "    int corner = gl_VertexID - quad * 6;\n"
+        "    corner = corner < 3 ? corner : (corner - 1) & 3;\n"
+        "    vec2 offset = vec2(((corner + 1) >> 1 & 1) * 2 - 1,\n"
+        "                       (corner >> 1) * 2 - 1);\n"
+        "    vec2 cell = vec2(texelFetch(cells, first + quad).xy);\n"
+        "    vec2 position = (cell + offset) * scale;\n"
+        "    gl_Position = mvp * vec4(position, 0.0f, 1.0f);\n"
+        "    vertexColor = texelFetch(colours, colour_first + quad).rgb;\n"
+        "}\n\0";
+static char *quads_fs =
+        "#version 330 core\n"
+        "out vec4 FragColor;\n"
+        "in vec3 vertexColor;\n"
+        "void main()\n"
+        "{\n"
+        "    FragColor = vec4(vertexColor, 1.0f);\n"
+        "}\n\0";
+
+// one 4 byte record per grain, the unit quad is expanded from
+// gl_VertexID as a triangle strip
+static char *instanced_vs =
+        "#version 330 core\n"
+        "layout (location = 0) in uint in_Record;\n"
+        "uniform mat4 mvp;\n"
+        "uniform float scale;\n"
+        "uniform vec3 palette[16];\n"
+        "out vec3 vertexColor;\n"
+        "void main()\n"
+        "{\n"
+        "    vec2 cell = vec2(in_Record & 0xfffu, in_Record >> 12 & 0xfffu);\n"
+        "    vec2 offset = vec2((gl_VertexID & 1) * 2 - 1,\n"
+        "                       (gl_VertexID >> 1) * 2 - 1);\n"
+        "    vec2 position = (cell + offset) * scale;\n"
+        "    gl_Position = mvp * vec4(position, 0.0f, 1.0f);\n"
+        "    vertexColor = palette[in_Record >> 24 & 15u];\n"
+        "}\n\0";
+
+// one triangle, (-1, -1) (3, -1) (-1, 3), covers the screen. the world
+// position is interpolated across it and every fragment looks its cell up
+static char *texture_vs =
+        "#version 330 core\n"
+        "uniform mat4 inverse_mvp;\n"
+        "out vec2 world;\n"
+        "void main()\n"
+        "{\n"
+        "    vec2 ndc = vec2(float((gl_VertexID & 1) << 2) - 1.0f,\n"
+        "                    float((gl_VertexID & 2) << 1) - 1.0f);\n"
+        "    world = (inverse_mvp * vec4(ndc, 0.0f, 1.0f)).xy;\n"
+        "    gl_Position = vec4(ndc, 0.0f, 1.0f);\n"
+        "}\n\0";
+static char *texture_fs =
+        "#version 330 core\n"
+        "uniform usampler2D materials;\n"
+        "uniform vec3 palette[16];\n"
+        "uniform float scale;\n"
+        "in vec2 world;\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "    ivec2 cell = ivec2(floor(world / scale));\n"
+        "    if (any(lessThan(cell, ivec2(0))) ||\n"
+        "        any(greaterThanEqual(cell, textureSize(materials, 0)))) {\n"
+        "        discard;\n"
+        "    }\n"
+        "    uint material = texelFetch(materials, cell, 0).r;\n"
+        "    if (material == 0u) {\n"
+        "        discard;\n"
+        "    }\n"
+        "    FragColor = vec4(palette[material & 15u], 1.0f);\n"
+        "}\n\0";
+
+render_mode_e render_mode_parse(const char *name) {
+    if (strcmp(name, "quads") == 0) {
+        return RENDER_QUADS;
+    }
+    if (strcmp(name, "texture") == 0) {
+        return RENDER_TEXTURE;
+    }
+    if (strcmp(name, "instanced") == 0) {
+        return RENDER_INSTANCED;
+    }
+    printf("Unknown render mode %s, expected quads, texture or instanced\n",
+           name);
+    exit(-1);
+}
+
+int render_snapshot_contents(render_mode_e mode) {
+    switch (mode) {
+        case RENDER_TEXTURE:
+            return SNAPSHOT_MATERIALS;
+        case RENDER_INSTANCED:
+            return SNAPSHOT_INSTANCES;
+        default:
+            return SNAPSHOT_QUADS;
+    }
+}
+
+// palette[material] from material_table, material 0 is empty and never
+// drawn
+static void palette_upload() {
+    GLfloat palette[16 * 3] = {0};
+    for (int type = 0; type < PIXEL_TYPES; type++) {
+        palette[(type + 1) * 3] = material_table[type].rgb.r / 255.0f;
+        palette[(type + 1) * 3 + 1] = material_table[type].rgb.g / 255.0f;
+        palette[(type + 1) * 3 + 2] = material_table[type].rgb.b / 255.0f;
+    }
+    glUseProgram(program);
+    glUniform3fv(shader_program_get_uniform_location(program, "palette"), 16,
+                 palette);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0;
+}
+
+// copies the span_count spans of stride byte records in data that changed
+// into target and returns where the upload starts, timed for
+// render_upload_seconds()
+static size_t upload(stream_t *target, const void *data, size_t size,
+                     const span_t *spans, int span_count, size_t stride) {
+    double start = now_seconds();
+    stream_range_t ranges[DIRTY_SPANS];
+    for (int s = 0; s < span_count; s++) {
+        ranges[s].offset = spans[s].first * stride;
+        ranges[s].size = spans[s].count * stride;
+    }
+    size_t offset = stream_upload_ranges(target, data, size, ranges,
+                                         span_count);
+    upload_seconds += now_seconds() - start;
+    return offset;
+}
+
+// creates a buffer texture of format over the buffer of stream on unit
+static GLuint buffer_texture(GLenum unit, GLenum format,
+                             const stream_t *stream) {
+    GLuint t;
+    glGenTextures(1, &t);
+    glActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_BUFFER, t);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, stream->buffer);
+    glActiveTexture(GL_TEXTURE0);
+    return t;
+}
+
+static void quads_init() {
+    program = shader_program_create_s(quads_vs, quads_fs);
+    shader_program_link(program);
+    mvp_uniform = shader_program_get_uniform_location(program, "mvp");
+    scale_uniform = shader_program_get_uniform_location(program, "scale");
+    first_uniform = shader_program_get_uniform_location(program, "first");
+    colour_first_uniform = shader_program_get_uniform_location(program,
+                                                               "colour_first");
+    glUseProgram(program);
+    glUniform1i(shader_program_get_uniform_location(program, "cells"), 1);
+    glUniform1i(shader_program_get_uniform_location(program, "colours"), 2);
+
+    // the quads have no attributes but core profile still wants a vao
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    stream_init(&stream, render_strategy, GL_TEXTURE_BUFFER,
+                MAX_PIXELS * sizeof(pixel_vertex_t));
+    stream_init(&colour_stream, render_strategy, GL_TEXTURE_BUFFER,
+                MAX_PIXELS * sizeof(pixel_colour_t));
+    cell_texture = buffer_texture(GL_TEXTURE1, GL_RG16UI, &stream);
+    colour_texture = buffer_texture(GL_TEXTURE2, GL_RGBA8, &colour_stream);
+}
+
+static void instanced_attributes(size_t offset) {
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(pixel_instance_t),
+                           (void *) offset);
+}
+
+static void instanced_init() {
+    program = shader_program_create_s(instanced_vs, quads_fs);
+    shader_program_bind_attribute_location(program, 0, "in_Record");
+    shader_program_link(program);
+    mvp_uniform = shader_program_get_uniform_location(program, "mvp");
+    scale_uniform = shader_program_get_uniform_location(program, "scale");
+    palette_upload();
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    stream_init(&stream, render_strategy, GL_ARRAY_BUFFER,
+                MAX_PIXELS * sizeof(pixel_instance_t));
+    instanced_attributes(0);
+    // one record per instance, not per vertex
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(0);
+}
+
+static void texture_init() {
+    program = shader_program_create_s(texture_vs, texture_fs);
+    shader_program_link(program);
+    inverse_mvp_uniform = shader_program_get_uniform_location(program,
+                                                              "inverse_mvp");
+    scale_uniform = shader_program_get_uniform_location(program, "scale");
+
+    palette_upload();
+    glUniform1i(shader_program_get_uniform_location(program, "materials"), 0);
+
+    // the triangle has no attributes but core profile still wants a vao
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // integer textures can't be filtered
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, W_WIDTH, W_HEIGHT, 0,
+                 GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+    // the material map goes through a pixel unpack buffer so it streams
+    // like the vertex data
+    stream_init(&stream, render_strategy, GL_PIXEL_UNPACK_BUFFER,
+                W_WIDTH * W_HEIGHT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+render_mode_e render_mode_supported(render_mode_e mode,
+                                    stream_strategy_e strategy) {
+    if (mode != RENDER_QUADS) {
+        return mode;
+    }
+    // every segment of the stream has to fit in the buffer texture
+    GLint texels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+    if (texels < MAX_PIXELS * stream_segments(strategy)) {
+        return RENDER_INSTANCED;
+    }
+    return mode;
+}
+
+void render_init(render_mode_e mode, stream_strategy_e strategy) {
+    if (render_mode_supported(mode, strategy) != mode) {
+        printf("Buffer textures are too small for the quads with %s "
+               "streaming, drawing instanced\n",
+               stream_strategy_name(strategy));
+        mode = render_mode_supported(mode, strategy);
+    }
+    render_mode = mode;
+    render_strategy = strategy;
+    upload_seconds = 0.0;
+    uploaded = NULL;
+    switch (mode) {
+        case RENDER_TEXTURE:
+            texture_init();
+            break;
+        case RENDER_INSTANCED:
+            instanced_init();
+            break;
+        default:
+            quads_init();
+            break;
+    }
+}
+
+double render_upload_seconds() {
+    return upload_seconds;
+}
+
+size_t render_upload_bytes() {
+    return stream.uploaded + colour_stream.uploaded;
+}
+
+void render_frame(const snapshot_t *snapshot, mat4x4 mvp, float scale) {
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glUniform1f(scale_uniform, scale);
+    bool fresh = snapshot != uploaded || snapshot->tick != uploaded_tick;
+    uploaded = snapshot;
+    uploaded_tick = snapshot->tick;
+
+    if (render_mode == RENDER_TEXTURE) {
+        mat4x4 inverse_mvp;
+        mat4x4_invert(inverse_mvp, mvp);
+        glUniformMatrix4fv(inverse_mvp_uniform, 1, GL_FALSE,
+                           (const GLfloat *) inverse_mvp);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (fresh) {
+            // grains index the spans, the material map is rebuilt whole
+            size_t offset = upload(&stream, snapshot->materials,
+                                   W_WIDTH * W_HEIGHT, NULL, -1, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, W_WIDTH, W_HEIGHT,
+                            GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                            (void *) offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            // the copy out of the segment is what the fence guards
+            stream_fence(&stream);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        return;
+    }
+
+    glUniformMatrix4fv(mvp_uniform, 1, GL_FALSE, (const GLfloat *) mvp);
+    if (render_mode == RENDER_INSTANCED) {
+        if (fresh) {
+            uploaded_offset = upload(&stream, snapshot->instances,
+                                     snapshot->instance_count *
+                                     sizeof(pixel_instance_t),
+                                     snapshot->spans, snapshot->span_count,
+                                     sizeof(pixel_instance_t));
+        }
+        instanced_attributes(uploaded_offset);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                              snapshot->instance_count);
+        stream_fence(&stream);
+        return;
+    }
+
+    if (fresh) {
+        uploaded_offset = upload(&stream, snapshot->vertices,
+                                 snapshot->quads * sizeof(pixel_vertex_t),
+                                 snapshot->spans, snapshot->span_count,
+                                 sizeof(pixel_vertex_t));
+    }
+    // most frames recolour nothing and leave the colour stream alone
+    if (fresh && snapshot->colour_span_count != 0) {
+        uploaded_colour_offset = upload(&colour_stream, snapshot->colours,
+                                        snapshot->quads *
+                                        sizeof(pixel_colour_t),
+                                        snapshot->colour_spans,
+                                        snapshot->colour_span_count,
+                                        sizeof(pixel_colour_t));
+    }
+    // the shader indexes records, the streams hand out byte offsets
+    glUniform1i(first_uniform,
+                (GLint) (uploaded_offset / sizeof(pixel_vertex_t)));
+    glUniform1i(colour_first_uniform,
+                (GLint) (uploaded_colour_offset / sizeof(pixel_colour_t)));
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, cell_texture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, colour_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glDrawArrays(GL_TRIANGLES, 0, snapshot->quads * 6);
+    stream_fence(&stream);
+    stream_fence(&colour_stream);
+}
+
+void render_terminate() {
+    glDeleteProgram(program);
+    glDeleteVertexArrays(1, &vao);
+    stream_terminate(&stream);
+    stream_terminate(&colour_stream);
+    if (cell_texture) {
+        glDeleteTextures(1, &cell_texture);
+        glDeleteTextures(1, &colour_texture);
+        cell_texture = 0;
+        colour_texture = 0;
+    }
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+}
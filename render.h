@@ -0,0 +1,57 @@
+//
+// Created by dbrent on 4/9/21.
+//
+
+#ifndef SAND_RENDER_H
+#define SAND_RENDER_H
+
+#include "linmath.h"
+#include "runner.h"
+#include "stream.h"
+
+typedef enum {
+    // one quad per grain, six vertices expanded in the shader from the
+    // snapshot's cells and colours, which it reads from buffer textures
+    RENDER_QUADS,
+    // the snapshot's material map uploaded as an R8 texture and coloured
+    // through a palette by a single full-screen triangle. the upload is
+    // W_WIDTH * W_HEIGHT bytes whatever the grain count.
+    RENDER_TEXTURE,
+    // one 4 byte pixel_instance_t per grain, expanded to a quad by
+    // glDrawArraysInstanced. as big as the quads' cells but with no
+    // colour stream to keep.
+    RENDER_INSTANCED
+} render_mode_e;
+
+// parses a --render argument, exits on an unknown mode
+render_mode_e render_mode_parse(const char *name);
+
+// the snapshot_content_e bits runner_start() has to publish for mode
+int render_snapshot_contents(render_mode_e mode);
+
+// mode, or RENDER_INSTANCED when the context's buffer textures are too
+// small for RENDER_QUADS streamed with strategy. needs a current GL
+// context.
+render_mode_e render_mode_supported(render_mode_e mode,
+                                    stream_strategy_e strategy);
+
+// creates the programs, buffers and textures of mode, streaming the
+// per-frame data with strategy, falling back as render_mode_supported()
+// says. needs a current GL context.
+void render_init(render_mode_e mode, stream_strategy_e strategy);
+
+// cpu time spent handing frame data to GL since render_init(), including
+// any wait on the driver or on a fence
+double render_upload_seconds();
+
+// bytes handed to GL since render_init(). only what changed is uploaded
+// where the stream strategy keeps the previous frame, see
+// stream_upload_ranges().
+size_t render_upload_bytes();
+
+// uploads and draws one snapshot
+void render_frame(const snapshot_t *snapshot, mat4x4 mvp, float scale);
+
+void render_terminate();
+
+#endif //SAND_RENDER_H
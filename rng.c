@@ -0,0 +1,21 @@
+//
+// Created by dbrent on 3/29/21.
+//
+
+#include "rng.h"
+
+uint64_t rng_global_seed = 1;
+rng_t rng_main = {0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL};
+
+void rng_init(rng_t *rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0;
+    rng->inc = (stream << 1u) | 1u;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+void rng_seed(uint64_t seed) {
+    rng_global_seed = seed;
+    rng_init(&rng_main, seed, 0);
+}
@@ -0,0 +1,49 @@
+//
+// Created by dbrent on 3/29/21.
+//
+
+#ifndef SAND_RNG_H
+#define SAND_RNG_H
+
+#include <stdint.h>
+
+// pcg32: 64-bit state, one independent stream per odd increment. every
+// generator is an explicit object, so each chunk or worker can own one and
+// a run is reproducible from rng_global_seed alone.
+typedef struct {
+    uint64_t state;
+    uint64_t inc;
+} rng_t;
+
+extern uint64_t rng_global_seed;
+
+// stream used by the spawner. it runs on the sim thread (the runner's tick
+// job), or on whatever thread drives sim_step() headless; never draw from
+// it on the render thread.
+extern rng_t rng_main;
+
+// sets rng_global_seed and reseeds rng_main. streams created afterwards with
+// rng_init(..., rng_global_seed, ...) derive from it.
+void rng_seed(uint64_t seed);
+
+void rng_init(rng_t *rng, uint64_t seed, uint64_t stream);
+
+static inline uint32_t rng_next(rng_t *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t) (((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t) (old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31u));
+}
+
+// [0, 1)
+static inline float rng_float(rng_t *rng) {
+    return (float) (rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+// [min, max)
+static inline float rng_range(rng_t *rng, float min, float max) {
+    return min + rng_float(rng) * (max - min);
+}
+
+#endif //SAND_RNG_H
@@ -0,0 +1,210 @@
+//
+// Created by dbrent on 4/2/21.
+//
+
+#include "runner.h"
+#include "sim.h"
+#include "world.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// set on middle when it holds a frame the reader hasn't taken yet
+#define MIDDLE_FRESH 4
+
+static snapshot_t snapshots[3];
+// back is only touched by the sim thread and front only by the reader, the
+// two swap buffers through middle
+static int back;
+static int front;
+static atomic_int middle;
+
+static pthread_t thread;
+static atomic_bool running;
+static runner_tick_f tick_job;
+static int snapshot_contents;
+// the reader has nothing uploaded yet, the next publish marks everything
+static bool publish_everything;
+// bumped by every publish that saw a recoloured grain
+static unsigned int colour_version;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0;
+}
+
+// grows buffer to hold count items of size bytes. buffers grow to what
+// the sim holds now rather than MAX_PIXELS, three full size quad buffers
+// would be 50 MB.
+static void *reserve(void *buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) {
+        return buffer;
+    }
+    int grown = count + count / 2;
+    if (grown > MAX_PIXELS) {
+        grown = MAX_PIXELS;
+    }
+    buffer = realloc(buffer, grown * size);
+    checkm(buffer);
+    *capacity = grown;
+    return buffer;
+}
+
+// the colours only change on spawn and repack, most publishes leave the
+// snapshot's copy alone
+static void copy_quads(snapshot_t *s, bool recoloured) {
+    int quads = sim_vertices();
+    s->vertices = reserve(s->vertices, &s->capacity, quads,
+                          sizeof(pixel_vertex_t));
+    memcpy(s->vertices, vertex_buffer, quads * sizeof(pixel_vertex_t));
+    if (recoloured) {
+        colour_version++;
+    }
+    if (s->colour_version != colour_version) {
+        s->colours = reserve(s->colours, &s->colour_capacity, quads,
+                             sizeof(pixel_colour_t));
+        memcpy(s->colours, colour_buffer, quads * sizeof(pixel_colour_t));
+        s->colour_version = colour_version;
+    }
+    s->quads = quads;
+}
+
+static void publish() {
+    snapshot_t *s = &snapshots[back];
+    s->span_count = sim_dirty_spans(s->spans, PARTICLE_DIRTY);
+    s->colour_span_count = sim_dirty_spans(s->colour_spans,
+                                           PARTICLE_RECOLOURED);
+    if (publish_everything) {
+        s->span_count = -1;
+        s->colour_span_count = -1;
+        publish_everything = false;
+    }
+    if (snapshot_contents & SNAPSHOT_QUADS) {
+        copy_quads(s, s->colour_span_count != 0);
+    }
+    if (snapshot_contents & SNAPSHOT_MATERIALS) {
+        sim_materials(s->materials);
+    }
+    if (snapshot_contents & SNAPSHOT_INSTANCES) {
+        s->instances = reserve(s->instances, &s->instance_capacity,
+                               pixel_count, sizeof(pixel_instance_t));
+        s->instance_count = sim_instances(s->instances);
+    }
+    // the reader hasn't taken the last publish and may never see it, so this
+    // one carries its changes too. if the reader takes it after all before
+    // the exchange below, it uploads a few spans twice.
+    int last = atomic_load(&middle);
+    if (last & MIDDLE_FRESH) {
+        const snapshot_t *skipped = &snapshots[last & ~MIDDLE_FRESH];
+        s->span_count = span_union(s->spans, s->span_count, skipped->spans,
+                                   skipped->span_count);
+        s->colour_span_count = span_union(s->colour_spans,
+                                          s->colour_span_count,
+                                          skipped->colour_spans,
+                                          skipped->colour_span_count);
+    }
+    s->pixels = pixel_count;
+    s->tick = sim_tick;
+    s->origin_x = world_origin_x;
+    s->origin_y = world_origin_y;
+    back = atomic_exchange(&middle, back | MIDDLE_FRESH) & ~MIDDLE_FRESH;
+}
+
+static void *sim_thread(void *unused) {
+    double last = now_seconds();
+    while (atomic_load(&running)) {
+        double now = now_seconds();
+        int ticks = sim_ticks_due(now - last);
+        last = now;
+        for (int t = 0; t < ticks; t++) {
+            if (tick_job) {
+                tick_job();
+            }
+            sim_step();
+        }
+        if (ticks > 0) {
+            publish();
+            continue;
+        }
+        // nothing due yet, doze for a fraction of a tick
+        double doze = 0.25 / sim_tick_rate;
+        struct timespec ts;
+        ts.tv_sec = (time_t) doze;
+        ts.tv_nsec = (long) ((doze - (double) ts.tv_sec) * 1000000000.0);
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+void runner_start(runner_tick_f tick, int contents) {
+    if (atomic_load(&running)) {
+        return;
+    }
+    for (int s = 0; s < 3; s++) {
+        snapshots[s].quads = 0;
+        snapshots[s].instance_count = 0;
+        snapshots[s].span_count = -1;
+        snapshots[s].colour_span_count = -1;
+        // never matches colour_version, the first publish copies colours
+        snapshots[s].colour_version = colour_version - 1;
+        snapshots[s].pixels = 0;
+        snapshots[s].tick = sim_tick;
+        snapshots[s].origin_x = world_origin_x;
+        snapshots[s].origin_y = world_origin_y;
+        // the reader may look at the materials before the first publish
+        if (contents & SNAPSHOT_MATERIALS) {
+            snapshots[s].materials = calloc(W_WIDTH * W_HEIGHT, 1);
+            checkm(snapshots[s].materials);
+        }
+    }
+    snapshot_contents = contents;
+    publish_everything = true;
+    front = 0;
+    back = 1;
+    atomic_store(&middle, 2);
+    tick_job = tick;
+    atomic_store(&running, true);
+    if (pthread_create(&thread, NULL, sim_thread, NULL) != 0) {
+        printf("Could not start the simulation thread\n");
+        exit(-1);
+    }
+}
+
+const snapshot_t *runner_acquire() {
+    if (atomic_load(&middle) & MIDDLE_FRESH) {
+        front = atomic_exchange(&middle, front) & ~MIDDLE_FRESH;
+    }
+    return &snapshots[front];
+}
+
+void runner_stop() {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    atomic_store(&running, false);
+    pthread_join(thread, NULL);
+    for (int s = 0; s < 3; s++) {
+        ffree(snapshots[s].vertices);
+        ffree(snapshots[s].colours);
+        ffree(snapshots[s].materials);
+        ffree(snapshots[s].instances);
+        snapshots[s].vertices = NULL;
+        snapshots[s].colours = NULL;
+        snapshots[s].materials = NULL;
+        snapshots[s].instances = NULL;
+        snapshots[s].capacity = 0;
+        snapshots[s].colour_capacity = 0;
+        snapshots[s].instance_capacity = 0;
+        snapshots[s].quads = 0;
+        snapshots[s].instance_count = 0;
+    }
+}
+
+bool runner_running() {
+    return atomic_load(&running);
+}
@@ -0,0 +1,76 @@
+//
+// Created by dbrent on 4/2/21.
+//
+
+#ifndef SAND_RUNNER_H
+#define SAND_RUNNER_H
+
+#include "sim.h"
+
+#include <stdbool.h>
+
+// what the sim thread copies into every snapshot, a renderer only asks
+// for what it draws
+typedef enum {
+    SNAPSHOT_QUADS = 1 << 0,
+    SNAPSHOT_MATERIALS = 1 << 1,
+    SNAPSHOT_INSTANCES = 1 << 2
+} snapshot_content_e;
+
+// a finished frame, copied out of the simulation after the sim thread's
+// last tick
+typedef struct {
+    // SNAPSHOT_QUADS: the cell and colour of quads quads
+    pixel_vertex_t *vertices;
+    pixel_colour_t *colours;
+    int quads;
+    int capacity;
+    int colour_capacity;
+    // which recolouring of the sim the colours were copied at
+    unsigned int colour_version;
+    // SNAPSHOT_MATERIALS: W_WIDTH * W_HEIGHT bytes, see sim_materials()
+    uint8_t *materials;
+    // SNAPSHOT_INSTANCES: one record per grain, see sim_instances()
+    pixel_instance_t *instances;
+    int instance_count;
+    int instance_capacity;
+    // the quads and instances that moved and the quads that were
+    // recoloured since the snapshot the reader took before this one, see
+    // sim_dirty_spans(). a count is -1 when everything has to be uploaded
+    // again.
+    span_t spans[DIRTY_SPANS];
+    int span_count;
+    span_t colour_spans[DIRTY_SPANS];
+    int colour_span_count;
+    int pixels;
+    unsigned int tick;
+    // world cell of window cell 0, 0 when the snapshot was taken, the
+    // camera draws relative to it, see world.h
+    int64_t origin_x;
+    int64_t origin_y;
+} snapshot_t;
+
+// called on the sim thread before every sim_step(), the place to spawn
+// grains. may be NULL.
+typedef void (*runner_tick_f)(void);
+
+// runs the simulation on its own thread at sim_tick_rate until
+// runner_stop(), publishing the snapshot_content_e bits in contents.
+// sim_init() must have been called; from here on only the sim thread (and
+// tick) may touch simulation state.
+void runner_start(runner_tick_f tick, int contents);
+
+// the most recently published snapshot. it is triple buffered: the sim
+// thread writes one buffer, one holds the latest finished frame and the
+// caller owns the returned one until its next call, so neither side ever
+// waits on the other. the result is never NULL, quads is 0 until the first
+// frame is published.
+const snapshot_t *runner_acquire();
+
+// stops and joins the sim thread and frees the snapshots, the caller owns
+// the simulation again
+void runner_stop();
+
+bool runner_running();
+
+#endif //SAND_RUNNER_H
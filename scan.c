@@ -0,0 +1,81 @@
+//
+// Created by dbrent on 3/22/21.
+//
+
+#include "scan.h"
+#include "cell.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+scan_f scan_free = scan_free_scalar;
+static const char *isa = "scalar";
+
+int scan_free_scalar(const uint8_t *cells, int start, int stride, int limit) {
+    int distance = 0;
+    while (distance < limit &&
+           (cells[start + distance * stride] & CELL_MATERIAL) == CELL_EMPTY) {
+        distance++;
+    }
+    return distance;
+}
+
+#ifdef SCAN_X86
+
+// rows are contiguous, so east and west runs test eight cells per load.
+// no material reaches further than 15 cells, a probe is at most 14, so
+// wider loads would never fill. columns and diagonals stay scalar:
+// gathering cells W_WIDTH apart costs more than the short probe it
+// replaces. west runs load the cells ending at the current one and take
+// the highest occupied lane.
+
+__attribute__((target("sse2")))
+static int scan_free_sse2(const uint8_t *cells, int start, int stride,
+                          int limit) {
+    if (stride != 1 && stride != -1) {
+        return scan_free_scalar(cells, start, stride, limit);
+    }
+    const __m128i material = _mm_set1_epi8(CELL_MATERIAL);
+    const __m128i empty = _mm_setzero_si128();
+    int distance = 0;
+    for (; distance + 8 <= limit; distance += 8) {
+        int p = start + distance * stride;
+        const uint8_t *from = stride == 1 ? cells + p : cells + p - 7;
+        __m128i v = _mm_and_si128(
+                _mm_loadl_epi64((const __m128i *) from), material);
+        int occupied = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, empty)) & 0xff;
+        if (occupied) {
+            return distance + (stride == 1 ? __builtin_ctz(occupied)
+                                           : __builtin_clz(occupied) - 24);
+        }
+    }
+    return distance + scan_free_scalar(cells, start + distance * stride,
+                                       stride, limit - distance);
+}
+
+#endif
+
+void scan_init() {
+    const char *force = getenv("SAND_SCAN");
+    scan_free = scan_free_scalar;
+    isa = "scalar";
+    if (force != NULL && strcmp(force, "scalar") == 0) {
+        return;
+    }
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        scan_free = scan_free_sse2;
+        isa = "sse2";
+    }
+#endif
+}
+
+const char *scan_isa() {
+    return isa;
+}
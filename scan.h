@@ -0,0 +1,33 @@
+//
+// Created by dbrent on 3/22/21.
+//
+
+#ifndef SAND_SCAN_H
+#define SAND_SCAN_H
+
+#include <stdint.h>
+
+// free-run scan of the cell engine's byte grid, SSE2 on x86 with a scalar
+// fallback. the particle engine doesn't use it: its update() probes the
+// occupancy bitmap (occupancy.h), which tests up to 64 cells per word.
+
+// counts the empty cells (material CELL_EMPTY) in cells[start],
+// cells[start + stride], ... up to limit cells and stops at the first
+// occupied one. the caller keeps the run inside the world, the kernels never
+// read past the last probed cell.
+typedef int (*scan_f)(const uint8_t *cells, int start, int stride,
+                      int limit);
+
+// kernel picked for the running cpu by scan_init()
+extern scan_f scan_free;
+
+// picks the scan_free kernel: sse2 where the cpu has it, scalar otherwise.
+// every x86-64 cpu has sse2, the check only matters for 32-bit x86 builds.
+// SAND_SCAN=scalar in the environment forces the scalar kernel.
+void scan_init();
+
+const char *scan_isa();
+
+int scan_free_scalar(const uint8_t *cells, int start, int stride, int limit);
+
+#endif //SAND_SCAN_H
@@ -0,0 +1,727 @@
+//
+// Created by dbrent on 3/6/21.
+//
+
+#include "sim.h"
+#include "cell.h"
+#include "chunk.h"
+#include "occupancy.h"
+#include "pool.h"
+#include "rng.h"
+#include "scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+pixel_vertex_t *vertex_buffer;
+pixel_colour_t *colour_buffer;
+float gravity;
+float scale;
+int pixel_count;
+unsigned int sim_tick;
+double sim_tick_rate = 60.0;
+int sim_max_ticks = 4;
+// wall time owed to the sim that doesn't add up to a whole tick yet
+static double tick_accumulator;
+sim_engine_e sim_engine = ENGINE_PARTICLES;
+int grid[GRID_CELLS];
+
+void checkm(void *obj) {
+    if (obj == NULL) {
+        printf("Could not allocate memory for object\n");
+        exit(-1);
+    }
+}
+
+void ffree(void *obj) {
+    if (obj != NULL) {
+        free(obj);
+        obj = NULL;
+    }
+}
+
+void grid_init() {
+    for (int x = 0; x < GRID_CELLS; x++) {
+        grid[x] = -1;
+    }
+}
+
+// cells outside the world count as occupied so probes never leave the grid
+static bool cell_free(int x, int y) {
+    return !occupancy_test(x, y);
+}
+
+// puts every grain in the rect back to work
+static void wake_rect(int min_x, int min_y, int max_x, int max_y) {
+    if (min_x < 0) { min_x = 0; }
+    if (min_y < 0) { min_y = 0; }
+    if (max_x > W_WIDTH - 1) { max_x = W_WIDTH - 1; }
+    if (max_y > W_HEIGHT - 1) { max_y = W_HEIGHT - 1; }
+    for (int y = min_y; y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            int i = grid[grid_index(x, y)];
+            if (i != -1) {
+                particles.flags[i] &= ~PARTICLE_ASLEEP;
+                particles.idle[i] = 0;
+            }
+        }
+    }
+}
+
+// whether a grain can move only depends on its 3x3 neighbourhood, so a
+// change to x, y is all it takes to put the grains around it back to work
+static void wake_around(int x, int y) {
+    wake_rect(x - 1, y - 1, x + 1, y + 1);
+}
+
+void sim_init() {
+    pixel_count = 0;
+    scale = 1.0f;
+    gravity = 1.0f;
+    sim_tick = 0;
+    tick_accumulator = 0.0;
+    rng_seed(rng_global_seed);
+    scan_init();
+    chunks_init();
+
+    vertex_buffer = malloc(MAX_PIXELS * sizeof(pixel_vertex_t));
+    checkm(vertex_buffer);
+    colour_buffer = malloc(MAX_PIXELS * sizeof(pixel_colour_t));
+    checkm(colour_buffer);
+
+    if (sim_engine == ENGINE_CELLS) {
+        cells_init();
+        return;
+    }
+    grid_init();
+    occupancy_clear();
+    particles_init(MAX_PIXELS);
+}
+
+static bool scan_left_to_right;
+static int phase_chunks[4][CHUNK_COUNT];
+static int phase_count[4];
+// update() calls during the last step, summed once per chunk
+static int updated;
+
+static void chunk_step(int item, void *arg) {
+    const int *list = arg;
+    int source = list[item];
+    if (sim_engine == ENGINE_CELLS) {
+        __atomic_fetch_add(&updated,
+                           cells_step_chunk(source, scan_left_to_right),
+                           __ATOMIC_RELAXED);
+        return;
+    }
+    const rect_t *r = &chunks[source].dirty;
+    int count = 0;
+    // bottom-up, so grains falling within the chunk land on scanned rows
+    for (int y = r->max_y; y >= r->min_y; y--) {
+        for (int n = 0; n <= r->max_x - r->min_x; n++) {
+            int x = scan_left_to_right ? r->min_x + n : r->max_x - n;
+            int i = grid[grid_index(x, y)];
+            if (i == -1) {
+                continue;
+            }
+            // a grain that moved into a not yet scanned cell already had its
+            // turn this tick
+            if (particles.tick[i] == sim_tick) {
+                continue;
+            }
+            // settled grains cost nothing until a neighbour wakes them, and
+            // one that just failed to move is retried after 2^idle ticks.
+            // either way its 3x3 hasn't changed, so it would fail again.
+            if (particles.flags[i] & PARTICLE_ASLEEP) {
+                continue;
+            }
+            int idle = particles.idle[i];
+            if (idle && (sim_tick & ((1u << idle) - 1)) != 0) {
+                continue;
+            }
+            particles.tick[i] = sim_tick;
+            update(i);
+            count++;
+        }
+    }
+    __atomic_fetch_add(&updated, count, __ATOMIC_RELAXED);
+}
+
+void sim_set_workers(int workers) {
+    pool_init(workers);
+}
+
+void sim_step() {
+    sim_tick++;
+    updated = 0;
+    chunks_swap();
+    // alternate the horizontal scan direction so water doesn't drift
+    scan_left_to_right = sim_tick % 2 == 0;
+
+    chunks_schedule(phase_chunks, phase_count, scan_left_to_right);
+    for (int p = 0; p < 4; p++) {
+        pool_run(chunk_step, phase_chunks[p], phase_count[p]);
+    }
+}
+
+int sim_ticks_due(double elapsed) {
+    double tick_length = 1.0 / sim_tick_rate;
+    tick_accumulator += elapsed;
+    int ticks = (int) (tick_accumulator / tick_length);
+    if (ticks > sim_max_ticks) {
+        ticks = sim_max_ticks;
+        tick_accumulator = 0.0;
+    } else {
+        tick_accumulator -= ticks * tick_length;
+    }
+    return ticks;
+}
+
+int sim_updated() {
+    return updated;
+}
+
+void sim_materials(uint8_t *materials) {
+    if (sim_engine == ENGINE_CELLS) {
+        cells_materials(materials);
+        return;
+    }
+    memset(materials, 0, W_WIDTH * W_HEIGHT);
+    for (int i = 0; i < pixel_count; i++) {
+        materials[particles.grid_x[i] + particles.grid_y[i] * W_WIDTH] =
+                (uint8_t) (particles.type[i] + 1);
+    }
+}
+
+int sim_instances(pixel_instance_t *instances) {
+    if (sim_engine == ENGINE_CELLS) {
+        return cells_instances(instances);
+    }
+    for (int i = 0; i < pixel_count; i++) {
+        instances[i] = PIXEL_INSTANCE(particles.grid_x[i], particles.grid_y[i],
+                                      particles.type[i] + 1);
+    }
+    return pixel_count;
+}
+
+int sim_vertices() {
+    if (sim_engine == ENGINE_CELLS) {
+        return cells_vertices(vertex_buffer, colour_buffer);
+    }
+    // particles write their own vertices when they spawn or move
+    return pixel_count;
+}
+
+// appends first .. end - 1 to the sorted spans, merging it into the last
+// span when it starts within DIRTY_SPAN_GAP of it. once the list is full
+// the last span grows to cover the rest.
+static void span_push(span_t *spans, int *count, int first, int end) {
+    if (*count > 0) {
+        span_t *last = &spans[*count - 1];
+        if (first <= last->first + last->count + DIRTY_SPAN_GAP ||
+            *count == DIRTY_SPANS) {
+            if (end > last->first + last->count) {
+                last->count = end - last->first;
+            }
+            return;
+        }
+    }
+    spans[*count].first = first;
+    spans[*count].count = end - first;
+    (*count)++;
+}
+
+int sim_dirty_spans(span_t *spans, particle_flag_e flag) {
+    if (sim_engine == ENGINE_CELLS) {
+        return -1;
+    }
+    // flag in each of 8 flags at once
+    const uint64_t dirty = 0x0101010101010101ull * flag;
+    int count = 0;
+    int i = 0;
+    while (i < pixel_count) {
+        // settled scenes are mostly clean, skip them 8 grains at a time
+        if (i + 8 <= pixel_count) {
+            uint64_t word;
+            memcpy(&word, particles.flags + i, sizeof(word));
+            if (!(word & dirty)) {
+                i += 8;
+                continue;
+            }
+        }
+        if (!(particles.flags[i] & flag)) {
+            i++;
+            continue;
+        }
+        int first = i;
+        while (i < pixel_count && (particles.flags[i] & flag)) {
+            particles.flags[i] &= ~flag;
+            i++;
+        }
+        span_push(spans, &count, first, i);
+    }
+    return count;
+}
+
+int span_union(span_t *spans, int count, const span_t *other,
+               int other_count) {
+    if (count < 0 || other_count < 0) {
+        return -1;
+    }
+    span_t merged[DIRTY_SPANS];
+    int merged_count = 0;
+    int a = 0;
+    int b = 0;
+    while (a < count || b < other_count) {
+        const span_t *next;
+        if (b == other_count ||
+            (a < count && spans[a].first <= other[b].first)) {
+            next = &spans[a++];
+        } else {
+            next = &other[b++];
+        }
+        span_push(merged, &merged_count, next->first,
+                  next->first + next->count);
+    }
+    memcpy(spans, merged, merged_count * sizeof(span_t));
+    return merged_count;
+}
+
+void sim_terminate() {
+    pool_terminate();
+    particles_terminate();
+    ffree(vertex_buffer);
+    ffree(colour_buffer);
+    vertex_buffer = NULL;
+    colour_buffer = NULL;
+    pixel_count = 0;
+}
+
+// the grain at x, y below a grain of density when it is lighter, -1 when
+// the cell is empty, outside the world or holds something as heavy
+static inline int lighter_below(int x, int y, int density) {
+    if (y >= W_HEIGHT) {
+        return -1;
+    }
+    int j = grid[grid_index(x, y)];
+    if (j == -1 || material_table[particles.type[j]].density >= density) {
+        return -1;
+    }
+    return j;
+}
+
+// grain i at x, y and the lighter grain j right below it trade places. both
+// cells stay occupied, so the occupancy bitmap doesn't change, only the two
+// grid cells and the two grains' cells and quads.
+static void sink(int i, int j, int x, int y) {
+    grid[grid_index(x, y)] = j;
+    grid[grid_index(x, y + 1)] = i;
+    particles.grid_y[i] = y + 1;
+    particles.grid_y[j] = y;
+    // j moved into a row that is being scanned, this was its turn
+    particles.tick[j] = sim_tick;
+    particles.flags[i] |= PARTICLE_DIRTY;
+    particles.flags[j] |= PARTICLE_DIRTY;
+    vertex_quad(vertex_buffer + i, x, y + 1);
+    vertex_quad(vertex_buffer + j, x, y);
+    int source = chunk_index(x, y);
+    chunk_wake(source, x, y);
+    chunk_wake(source, x, y + 1);
+    wake_around(x, y);
+    wake_around(x, y + 1);
+}
+
+// walks from x, y towards x + tx, y + ty (ty > 0) through the cells on the
+// line between them and stops in front of the first occupied one. the
+// cells travelled go to dx, dy. returns whether the whole way was free.
+static inline bool traverse(int x, int y, int tx, int ty, int *dx, int *dy) {
+    // straight down or diagonal is a single probe
+    if (tx == 0 || tx == ty || tx == -ty) {
+        int step_x = tx > 0 ? 1 : tx < 0 ? -1 : 0;
+        int distance = occupancy_free_down(x, y, step_x, ty);
+        *dx = distance * step_x;
+        *dy = distance;
+        return distance == ty;
+    }
+    int ax = tx < 0 ? -tx : tx;
+    int n = ax > ty ? ax : ty;
+    *dx = 0;
+    *dy = 0;
+    for (int k = 1; k <= n; k++) {
+        // nearest cell to the line, rounded the same way on either side
+        int cx = (2 * ax * k + n) / (2 * n);
+        int cy = (2 * ty * k + n) / (2 * n);
+        cx = tx < 0 ? -cx : cx;
+        if (occupancy_test(x + cx, y + cy)) {
+            return false;
+        }
+        *dx = cx;
+        *dy = cy;
+    }
+    return true;
+}
+
+// one tick of grain i under the rules of a material. only ever called with
+// constants from MATERIALS(), so every expansion below folds into a kernel
+// that probes just the directions its material moves in.
+static inline void update_rules(int i, int moves, int density, int fall,
+                                int spread, int friction) {
+    int old_x = particles.grid_x[i];
+    int old_y = particles.grid_y[i];
+    int pixel_x = old_x;
+    int pixel_y = old_y;
+    int grid_position = grid_index(pixel_x, pixel_y);
+    int dx = 0;
+    int dy = 0;
+
+    // probes read the occupancy bitmap, which treats everything outside the
+    // world as occupied. the chosen neighbour is free, so the grain moves at
+    // least one cell even when its friction allows no diagonal slide.
+    int lighter;
+    if ((moves & MOVE_DOWN) && cell_free(pixel_x, pixel_y + 1)) {
+        // in the air: gravity speeds it up to at most fall cells a tick and
+        // it only looks at the cells on its way
+        float vy = particles.vy[i] + gravity;
+        vy = vy > (float) fall ? (float) fall : vy;
+        int tx = (int) particles.vx[i];
+        int ty = vy < 1.0f ? 1 : (int) vy;
+        if (traverse(pixel_x, pixel_y, tx, ty, &dx, &dy)) {
+            particles.vy[i] = vy;
+        } else {
+            // landed on something
+            particles.vx[i] = 0.0f;
+            particles.vy[i] = 0.0f;
+        }
+        // the way sideways was blocked straight away, drop down instead
+        if (dx == 0 && dy == 0) {
+            particles.vx[i] = 0.0f;
+            dy = occupancy_free_down(pixel_x, pixel_y, 0, ty);
+        }
+    } else if ((moves & MOVE_SINK) &&
+               (lighter = lighter_below(pixel_x, pixel_y + 1, density)) != -1) {
+        sink(i, lighter, pixel_x, pixel_y);
+        return;
+    } else if ((moves & MOVE_DIAGONAL) && cell_free(pixel_x - 1, pixel_y + 1)) {
+        dy = occupancy_free_down(pixel_x, pixel_y, -1, friction - 1);
+        dy = dy < 1 ? 1 : dy;
+        dx = -dy;
+        // rolling off keeps it drifting that way while it falls
+        particles.vx[i] = -1.0f;
+    } else if ((moves & MOVE_DIAGONAL) && cell_free(pixel_x + 1, pixel_y + 1)) {
+        dy = occupancy_free_down(pixel_x, pixel_y, 1, friction - 1);
+        dy = dy < 1 ? 1 : dy;
+        dx = dy;
+        particles.vx[i] = 1.0f;
+    } else if ((moves & MOVE_SIDEWAYS) && cell_free(pixel_x - 1, pixel_y)) {
+        dx = -occupancy_free_west(pixel_x, pixel_y, spread - 1);
+    } else if ((moves & MOVE_SIDEWAYS) && cell_free(pixel_x + 1, pixel_y)) {
+        dx = occupancy_free_east(pixel_x, pixel_y, spread - 1);
+    }
+
+    if (dx == 0 && dy == 0) {
+        particles.vx[i] = 0.0f;
+        if (++particles.idle[i] >= PARTICLE_SLEEP_AFTER) {
+            particles.flags[i] |= PARTICLE_ASLEEP;
+        }
+        return;
+    }
+
+    // every probe treats the outside of the world as occupied, so the
+    // landing cell is always inside it
+    pixel_x += dx;
+    pixel_y += dy;
+
+    particles.grid_x[i] = pixel_x;
+    particles.grid_y[i] = pixel_y;
+    particles.flags[i] |= PARTICLE_DIRTY;
+    int new_position = grid_index(pixel_x, pixel_y);
+    grid[new_position] = i;
+    grid[grid_position] = -1;
+    occupancy_reset(old_x, old_y);
+    occupancy_set(pixel_x, pixel_y);
+    // the vacated cell and the landing cell both change the neighbourhood.
+    // both wakes are raised by the chunk being stepped, which holds the
+    // vacated cell
+    int source = chunk_index(old_x, old_y);
+    chunk_wake(source, old_x, old_y);
+    chunk_wake(source, pixel_x, pixel_y);
+    wake_around(old_x, old_y);
+    wake_around(pixel_x, pixel_y);
+
+    // the colour doesn't change, only the cell the quad is drawn at
+    vertex_quad(vertex_buffer + i, pixel_x, pixel_y);
+}
+
+#define MATERIAL_UPDATE(name, r, g, b, density, fall, spread, friction, \
+                        moves) \
+        static void update_##name(int i) { \
+            update_rules(i, moves, density, fall, spread, friction); \
+        }
+MATERIALS(MATERIAL_UPDATE)
+
+#define MATERIAL_KERNEL(name, r, g, b, density, fall, spread, friction, \
+                        moves) update_##name,
+static void (*const update_kernels[PIXEL_TYPES])(int) = {
+        MATERIALS(MATERIAL_KERNEL)
+};
+
+void update(int i) {
+    update_kernels[particles.type[i]](i);
+}
+
+void vertex_quad(pixel_vertex_t *quad, int x, int y) {
+    quad->x = (uint16_t) x;
+    quad->y = (uint16_t) y;
+}
+
+void colour_quad(pixel_colour_t *quad, rgb_t rgb) {
+    quad->rgb = rgb;
+    quad->pad = 0;
+}
+
+void repack(int hole) {
+    int last = pixel_count - 1;
+    if (hole < 0 || hole >= last) {
+        return;
+    }
+    particles_copy(hole, last);
+    particles.flags[hole] |= PARTICLE_DIRTY | PARTICLE_RECOLOURED;
+    particles.flags[last] = 0;
+    grid[grid_index(particles.grid_x[hole], particles.grid_y[hole])] = hole;
+    vertex_buffer[hole] = vertex_buffer[last];
+    colour_buffer[hole] = colour_buffer[last];
+}
+
+// fills the next free slot with a grain at the free cell x, y. the caller
+// wakes the neighbourhood.
+static void particle_spawn(int x, int y, pixel_type_e type) {
+    // live particles are kept dense, the next free slot is always the end
+    int i = pixel_count++;
+    particles.flags[i] = PARTICLE_ALIVE | PARTICLE_DIRTY | PARTICLE_RECOLOURED;
+    particles.tick[i] = sim_tick;
+    particles.idle[i] = 0;
+    particles.type[i] = (uint8_t) type;
+    particles.vx[i] = 0.0f;
+    particles.vy[i] = 0.0f;
+    particles.grid_x[i] = x;
+    particles.grid_y[i] = y;
+    vertex_quad(vertex_buffer + i, x, y);
+    colour_quad(colour_buffer + i, material_table[type].rgb);
+    grid[grid_index(x, y)] = i;
+    occupancy_set(x, y);
+}
+
+bool pixel_add(float x, float y, pixel_type_e type) {
+    if (sim_engine == ENGINE_CELLS) {
+        if (cell_add((int) x, (int) y, type)) {
+            pixel_count++;
+            return true;
+        }
+        return false;
+    }
+    if (pixel_count >= MAX_PIXELS - 10) {
+        return false;
+    }
+
+    if (x < 1) {
+        x = 1;
+    }
+    if (x > W_WIDTH - 1) {
+        x = W_WIDTH - 1;
+    }
+    if (y < 1) {
+        y = 1;
+    }
+    if (y > W_HEIGHT - 1) {
+        y = W_HEIGHT - 1;
+    }
+
+    int pixel_x = (int) x;
+    int pixel_y = (int) y;
+    if (occupancy_test(pixel_x, pixel_y)) {
+        return false;
+    }
+    particle_spawn(pixel_x, pixel_y, type);
+    chunk_wake(chunk_index(pixel_x, pixel_y), pixel_x, pixel_y);
+    wake_around(pixel_x, pixel_y);
+    return true;
+}
+
+int pixel_add_batch(const brush_t *brush) {
+    int r = brush->radius;
+    int min_x = brush->x - r > 0 ? brush->x - r : 0;
+    int min_y = brush->y - r > 0 ? brush->y - r : 0;
+    int max_x = brush->x + r < W_WIDTH - 1 ? brush->x + r : W_WIDTH - 1;
+    int max_y = brush->y + r < W_HEIGHT - 1 ? brush->y + r : W_HEIGHT - 1;
+    int added = 0;
+
+    for (int y = min_y; y <= max_y; y++) {
+        int dy = y - brush->y;
+        for (int x = min_x; x <= max_x; x++) {
+            int dx = x - brush->x;
+            if (brush->shape == BRUSH_CIRCLE && dx * dx + dy * dy > r * r) {
+                continue;
+            }
+            if (brush->density < 1.0f &&
+                rng_float(&rng_main) >= brush->density) {
+                continue;
+            }
+            if (sim_engine == ENGINE_CELLS) {
+                if (cell_add(x, y, brush->material)) {
+                    pixel_count++;
+                    added++;
+                }
+                continue;
+            }
+            if (pixel_count >= MAX_PIXELS - 10) {
+                break;
+            }
+            if (occupancy_test(x, y)) {
+                continue;
+            }
+            particle_spawn(x, y, brush->material);
+            added++;
+        }
+    }
+
+    // one wake for the whole brush instead of one per grain
+    if (added && sim_engine == ENGINE_PARTICLES) {
+        chunk_wake_rect(min_x, min_y, max_x, max_y);
+        wake_rect(min_x - 1, min_y - 1, max_x + 1, max_y + 1);
+    }
+    return added;
+}
+
+void pixel_destroy(int i) {
+    // cells have no particle index to destroy by
+    if (sim_engine == ENGINE_CELLS || i < 0 || i >= pixel_count ||
+        !(particles.flags[i] & PARTICLE_ALIVE)) {
+        return;
+    }
+    particles.flags[i] = 0;
+    int x = particles.grid_x[i];
+    int y = particles.grid_y[i];
+    grid[grid_index(x, y)] = -1;
+    occupancy_reset(x, y);
+    chunk_wake(chunk_index(x, y), x, y);
+    wake_around(x, y);
+    repack(i);
+    pixel_count--;
+}
+
+void sim_region_materials(int min_x, int min_y, int width, int height,
+                          uint8_t *materials) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t material = 0;
+            if (sim_engine == ENGINE_CELLS) {
+                material = cells[min_x + x + (min_y + y) * W_WIDTH] &
+                           CELL_MATERIAL;
+            } else {
+                int i = grid[grid_index(min_x + x, min_y + y)];
+                if (i != -1) {
+                    material = (uint8_t) (particles.type[i] + 1);
+                }
+            }
+            materials[x + y * width] = material;
+        }
+    }
+}
+
+int sim_region_load(int min_x, int min_y, int width, int height,
+                    const uint8_t *materials) {
+    int added = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t material = materials[x + y * width];
+            if (material == 0) {
+                continue;
+            }
+            pixel_type_e type = (pixel_type_e) (material - 1);
+            if (sim_engine == ENGINE_CELLS) {
+                if (cell_add(min_x + x, min_y + y, type)) {
+                    pixel_count++;
+                    added++;
+                }
+                continue;
+            }
+            if (pixel_count >= MAX_PIXELS - 10) {
+                break;
+            }
+            if (occupancy_test(min_x + x, min_y + y)) {
+                continue;
+            }
+            particle_spawn(min_x + x, min_y + y, type);
+            added++;
+        }
+    }
+    // the grains next to the region leaned on the edge of the world or on
+    // nothing, they have to look again too
+    if (sim_engine == ENGINE_PARTICLES) {
+        chunk_wake_rect(min_x, min_y, min_x + width - 1, min_y + height - 1);
+        wake_rect(min_x - 1, min_y - 1, min_x + width, min_y + height);
+    }
+    return added;
+}
+
+// wakes the grains along the edges of the window a shift by dx, dy moved
+// the old contents away from. they leaned on the edge of the world, which
+// is now empty space whether or not anything is loaded into it.
+static void wake_seams(int dx, int dy) {
+    if (dx >= W_WIDTH || -dx >= W_WIDTH || dy >= W_HEIGHT ||
+        -dy >= W_HEIGHT) {
+        return;
+    }
+    rect_t seams[2] = {{0, 0, -1, -1}, {0, 0, -1, -1}};
+    if (dx != 0) {
+        int x = dx > 0 ? dx : W_WIDTH + dx - 1;
+        seams[0] = (rect_t) {x, 0, x, W_HEIGHT - 1};
+    }
+    if (dy != 0) {
+        int y = dy > 0 ? dy : W_HEIGHT + dy - 1;
+        seams[1] = (rect_t) {0, y, W_WIDTH - 1, y};
+    }
+    for (int s = 0; s < 2; s++) {
+        const rect_t *r = &seams[s];
+        if (r->min_x > r->max_x) {
+            continue;
+        }
+        chunk_wake_rect(r->min_x, r->min_y, r->max_x, r->max_y);
+        if (sim_engine == ENGINE_PARTICLES) {
+            wake_rect(r->min_x - 1, r->min_y - 1, r->max_x + 1,
+                      r->max_y + 1);
+        }
+    }
+}
+
+void sim_shift(int dx, int dy) {
+    if (sim_engine == ENGINE_CELLS) {
+        pixel_count = cells_shift(dx, dy);
+        wake_seams(dx, dy);
+        return;
+    }
+    // drop the grains that leave first, while grid[] still matches them.
+    // going down from the end, the grain repacked into a hole was already
+    // looked at.
+    for (int i = pixel_count - 1; i >= 0; i--) {
+        int x = particles.grid_x[i] + dx;
+        int y = particles.grid_y[i] + dy;
+        if (x < 0 || x >= W_WIDTH || y < 0 || y >= W_HEIGHT) {
+            pixel_destroy(i);
+        }
+    }
+    grid_init();
+    occupancy_clear();
+    for (int i = 0; i < pixel_count; i++) {
+        int x = particles.grid_x[i] + dx;
+        int y = particles.grid_y[i] + dy;
+        particles.grid_x[i] = x;
+        particles.grid_y[i] = y;
+        particles.flags[i] |= PARTICLE_DIRTY;
+        vertex_quad(vertex_buffer + i, x, y);
+        grid[grid_index(x, y)] = i;
+        occupancy_set(x, y);
+    }
+    chunks_shift(dx, dy);
+    wake_seams(dx, dy);
+}
@@ -0,0 +1,235 @@
+//
+// Created by dbrent on 3/6/21.
+//
+
+#ifndef SAND_SIM_H
+#define SAND_SIM_H
+
+#include "material.h"
+#include "particles.h"
+
+#include <stdbool.h>
+
+#define W_WIDTH 1920
+#define W_HEIGHT 1080
+#define MAX_PIXELS (1920 * 1080)
+
+// memory layout of grid[], picked at build time with SAND_GRID_LAYOUT.
+// row-major puts the cell below 7.5 KB away; the tiled layouts keep a
+// grain's vertical neighbours on the same or a nearby cache line.
+//   rows:   x + y * W_WIDTH
+//   tiled:  8x8 tiles, row-major inside each tile
+//   morton: chunk sized 64x64 tiles, z-order inside each tile
+#if defined(SAND_GRID_TILED)
+#define GRID_TILE 8
+#define GRID_LAYOUT "tiled"
+#elif defined(SAND_GRID_MORTON)
+#define GRID_TILE 64
+#define GRID_LAYOUT "morton"
+#else
+#define GRID_TILE 1
+#define GRID_LAYOUT "rows"
+#endif
+#define GRID_TILES_X ((W_WIDTH + GRID_TILE - 1) / GRID_TILE)
+#define GRID_TILES_Y ((W_HEIGHT + GRID_TILE - 1) / GRID_TILE)
+#define GRID_CELLS (GRID_TILES_X * GRID_TILES_Y * GRID_TILE * GRID_TILE)
+
+typedef enum {
+    N, E, S, W, NE, NW, SE, SW
+} pixel_direction_e;
+
+typedef enum {
+    BRUSH_CIRCLE, BRUSH_RECT
+} brush_shape_e;
+
+// a circle of radius, or a square reaching radius cells from the centre
+// x, y. every free cell inside spawns a grain of material with probability
+// density.
+typedef struct {
+    brush_shape_e shape;
+    int x;
+    int y;
+    int radius;
+    float density;
+    pixel_type_e material;
+} brush_t;
+
+typedef enum {
+    // pixels[] particles indexed from grid[]
+    ENGINE_PARTICLES,
+    // materials stored directly in cells[], see cell.h
+    ENGINE_CELLS
+} sim_engine_e;
+
+// the dynamic half of a quad, rewritten whenever a grain moves. one per
+// grain, the vertex shader fetches it for quad gl_VertexID / 6, picks the
+// corner from the rest and scales it to the screen.
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+} pixel_vertex_t;
+
+// the static half, in its own buffer so it is only uploaded again when a
+// grain spawns or a destroy repacks one into another slot
+typedef struct {
+    rgb_t rgb;
+    uint8_t pad;
+} pixel_colour_t;
+
+// one grain for the instanced renderer, x | y << 12 | material << 24 with
+// material pixel_type_e + 1
+typedef uint32_t pixel_instance_t;
+#define PIXEL_INSTANCE(x, y, material) \
+        ((pixel_instance_t) (x) | (pixel_instance_t) (y) << 12 | \
+         (pixel_instance_t) (material) << 24)
+
+// particles first .. first + count - 1, whose quads and instances changed
+typedef struct {
+    int first;
+    int count;
+} span_t;
+
+// sim_dirty_spans() hands out at most this many spans. runs of changed
+// particles closer than DIRTY_SPAN_GAP are merged into one span, a few
+// clean quads cost less to upload again than another upload call.
+#define DIRTY_SPANS 64
+#define DIRTY_SPAN_GAP 64
+
+// simulation state. owned by libsand, read by the front-end
+extern pixel_vertex_t *vertex_buffer;
+extern pixel_colour_t *colour_buffer;
+// cells per tick added to the speed of a falling grain every tick
+extern float gravity;
+// size of a cell on screen, only the vertex shader applies it
+extern float scale;
+extern int pixel_count;
+extern unsigned int sim_tick;
+// simulated ticks per second and the most ticks sim_ticks_due() hands out
+// for one frame, see there
+extern double sim_tick_rate;
+extern int sim_max_ticks;
+extern sim_engine_e sim_engine;
+extern int grid[GRID_CELLS];
+
+#if defined(SAND_GRID_MORTON)
+// spreads the low 6 bits of v out to the even bits
+static inline int grid_spread(int v) {
+    v = (v | v << 4) & 0x0f0f;
+    v = (v | v << 2) & 0x3333;
+    v = (v | v << 1) & 0x5555;
+    return v;
+}
+#endif
+
+// index of cell x, y in grid[]. always go through this, never x + y * W
+static inline int grid_index(int x, int y) {
+#if defined(SAND_GRID_TILED)
+    int tile = (y >> 3) * GRID_TILES_X + (x >> 3);
+    return tile * 64 + ((y & 7) << 3) + (x & 7);
+#elif defined(SAND_GRID_MORTON)
+    int tile = (y >> 6) * GRID_TILES_X + (x >> 6);
+    return tile * 4096 + (grid_spread(y & 63) << 1 | grid_spread(x & 63));
+#else
+    return x + y * W_WIDTH;
+#endif
+}
+
+void checkm(void *obj);
+
+void ffree(void *obj);
+
+void grid_init();
+
+// allocates the vertex buffer and the state of sim_engine, which has to be
+// chosen before this is called, clears the grid and reseeds rng_main from
+// rng_global_seed
+void sim_init();
+
+// number of threads sim_step() spreads chunks over, including the caller.
+// the result of a step does not depend on it.
+void sim_set_workers(int workers);
+
+// advances the grains inside every awake chunk by one tick
+void sim_step();
+
+// fixed timestep clock. adds elapsed wall seconds to the accumulator and
+// returns how many sim_step() calls are due, 0 when the frame was shorter
+// than a tick. a slow frame owes at most sim_max_ticks, the rest of the
+// backlog is dropped so the sim slows down instead of spiralling.
+int sim_ticks_due(double elapsed);
+
+// number of grains the last sim_step() updated. everything else cost
+// nothing: grains outside every awake chunk's dirty rect are never looked
+// at, and asleep or backed off ones are skipped.
+int sim_updated();
+
+// writes the material of every cell, row-major W_WIDTH * W_HEIGHT bytes,
+// pixel_type_e + 1 or 0 for an empty cell
+void sim_materials(uint8_t *materials);
+
+// writes one record per grain, at least pixel_count of them fit, and
+// returns how many it wrote
+int sim_instances(pixel_instance_t *instances);
+
+// brings vertex_buffer and colour_buffer up to date and returns the number
+// of quads in them
+int sim_vertices();
+
+// collects the particles marked with flag since the last call for it into
+// at most DIRTY_SPANS sorted spans and clears the marks. PARTICLE_DIRTY
+// covers the cells in vertex_buffer and the instances, PARTICLE_RECOLOURED
+// colour_buffer. returns the number of spans, or -1 when everything has to
+// be treated as changed (the cell engine rebuilds its buffers every time).
+int sim_dirty_spans(span_t *spans, particle_flag_e flag);
+
+// adds the spans in other to the count spans in spans, which has room for
+// DIRTY_SPANS, and returns the new count. -1 on either side means
+// everything changed.
+int span_union(span_t *spans, int count, const span_t *other,
+               int other_count);
+
+// copies the materials of the width x height cells from min_x, min_y to
+// materials, row-major, pixel_type_e + 1 or 0 for an empty cell
+void sim_region_materials(int min_x, int min_y, int width, int height,
+                          uint8_t *materials);
+
+// spawns a grain for every material in a region laid out the way
+// sim_region_materials() writes it, skipping occupied cells, wakes the
+// region and its border and returns how many grains it added
+int sim_region_load(int min_x, int min_y, int width, int height,
+                    const uint8_t *materials);
+
+// moves every grain and pending wake by dx, dy cells, for when the window
+// moves over the world, and drops the grains that leave it. a grain keeps
+// its velocity and sleep, only its quad has to be uploaded again. the
+// grains along the seam to the cells shifted in are woken, they lost the
+// edge of the world they leaned on.
+void sim_shift(int dx, int dy);
+
+void sim_terminate();
+
+void update(int i);
+
+// writes the cell of a quad
+void vertex_quad(pixel_vertex_t *quad, int x, int y);
+
+// writes the colour of a quad
+void colour_quad(pixel_colour_t *quad, rgb_t rgb);
+
+// moves the last live particle into slot hole and patches its grid cell and
+// quad, so particles stay dense in 0..pixel_count - 1 and the update, upload
+// and draw never see a dead slot. O(1).
+void repack(int hole);
+
+// spawns a grain at x, y unless the cell is taken. returns whether it did.
+bool pixel_add(float x, float y, pixel_type_e type);
+
+// spawns a brush full of grains in one pass, skipping occupied cells, and
+// returns how many it added. draws from rng_main.
+int pixel_add_batch(const brush_t *brush);
+
+// frees particle i and fills its slot with the last particle, which changes
+// that particle's index to i. does nothing under ENGINE_CELLS.
+void pixel_destroy(int i);
+
+#endif //SAND_SIM_H
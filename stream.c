@@ -0,0 +1,191 @@
+//
+// Created by dbrent on 4/14/21.
+//
+
+#include "stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *strategy_names[STREAM_STRATEGIES] = {
+        "subdata", "orphan", "persistent"
+};
+
+stream_strategy_e stream_strategy_parse(const char *name) {
+    for (int s = 0; s < STREAM_STRATEGIES; s++) {
+        if (strcmp(name, strategy_names[s]) == 0) {
+            return (stream_strategy_e) s;
+        }
+    }
+    printf("Unknown stream strategy %s, expected subdata, orphan or "
+           "persistent\n", name);
+    exit(-1);
+}
+
+const char *stream_strategy_name(stream_strategy_e strategy) {
+    return strategy_names[strategy];
+}
+
+int stream_segments(stream_strategy_e strategy) {
+    if (strategy == STREAM_PERSISTENT && GLEW_ARB_buffer_storage) {
+        return STREAM_SEGMENTS;
+    }
+    return 1;
+}
+
+void stream_init(stream_t *stream, stream_strategy_e strategy, GLenum target,
+                 size_t size) {
+    memset(stream, 0, sizeof(*stream));
+    if (strategy == STREAM_PERSISTENT && stream_segments(strategy) == 1) {
+        printf("ARB_buffer_storage is not available, streaming with "
+               "orphan\n");
+        strategy = STREAM_ORPHAN;
+    }
+    stream->strategy = strategy;
+    stream->target = target;
+    stream->segment_size = size;
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(target, stream->buffer);
+
+    if (strategy != STREAM_PERSISTENT) {
+        glBufferData(target, size, NULL, GL_STREAM_DRAW);
+        return;
+    }
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                       GL_MAP_COHERENT_BIT;
+    glBufferStorage(target, size * STREAM_SEGMENTS, NULL, flags);
+    stream->mapped = glMapBufferRange(target, 0, size * STREAM_SEGMENTS,
+                                      flags);
+    if (stream->mapped == NULL) {
+        printf("Could not map the stream buffer\n");
+        exit(-1);
+    }
+}
+
+size_t stream_upload(stream_t *stream, const void *data, size_t size) {
+    return stream_upload_ranges(stream, data, size, NULL, -1);
+}
+
+// copies the parts of ranges inside size bytes from data to the buffer at
+// base, through glBufferSubData or into the mapping
+static void copy_ranges(stream_t *stream, size_t base, const void *data,
+                        size_t size, const stream_range_t *ranges,
+                        int count) {
+    for (int r = 0; r < count; r++) {
+        if (ranges[r].offset >= size) {
+            continue;
+        }
+        size_t length = ranges[r].size;
+        if (length > size - ranges[r].offset) {
+            length = size - ranges[r].offset;
+        }
+        const char *from = (const char *) data + ranges[r].offset;
+        if (stream->mapped) {
+            memcpy((char *) stream->mapped + base + ranges[r].offset, from,
+                   length);
+        } else {
+            glBufferSubData(stream->target, (GLintptr) ranges[r].offset,
+                            (GLsizeiptr) length, from);
+        }
+        stream->uploaded += length;
+    }
+}
+
+size_t stream_upload_ranges(stream_t *stream, const void *data, size_t size,
+                            const stream_range_t *ranges, int count) {
+    if (size > stream->segment_size) {
+        size = stream->segment_size;
+    }
+    if (count > STREAM_RANGES) {
+        count = -1;
+    }
+    stream_range_t everything = {0, size};
+    glBindBuffer(stream->target, stream->buffer);
+    switch (stream->strategy) {
+        case STREAM_SUBDATA:
+            if (count < 0 || !stream->filled[0]) {
+                copy_ranges(stream, 0, data, size, &everything, 1);
+                stream->filled[0] = true;
+            } else {
+                copy_ranges(stream, 0, data, size, ranges, count);
+            }
+            return 0;
+        case STREAM_ORPHAN:
+            glBufferData(stream->target, stream->segment_size, NULL,
+                         GL_STREAM_DRAW);
+            copy_ranges(stream, 0, data, size, &everything, 1);
+            return 0;
+        default:
+            break;
+    }
+
+    stream->segment = (stream->segment + 1) % STREAM_SEGMENTS;
+    GLsync fence = stream->fences[stream->segment];
+    if (fence) {
+        // only blocks when the gpu is STREAM_SEGMENTS - 1 frames behind
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                1000000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fence);
+        stream->fences[stream->segment] = NULL;
+    }
+    size_t offset = stream->segment * stream->segment_size;
+    // the segment missed this upload and the ones written to the others
+    // since it was last written
+    bool whole = count < 0 || !stream->filled[stream->segment];
+    for (int h = 0; h < STREAM_SEGMENTS - 1; h++) {
+        whole = whole || stream->history_count[h] < 0;
+    }
+    if (whole) {
+        copy_ranges(stream, offset, data, size, &everything, 1);
+        stream->filled[stream->segment] = true;
+    } else {
+        copy_ranges(stream, offset, data, size, ranges, count);
+        for (int h = 0; h < STREAM_SEGMENTS - 1; h++) {
+            copy_ranges(stream, offset, data, size, stream->history[h],
+                        stream->history_count[h]);
+        }
+    }
+    for (int h = STREAM_SEGMENTS - 2; h > 0; h--) {
+        memcpy(stream->history[h], stream->history[h - 1],
+               sizeof(stream->history[h]));
+        stream->history_count[h] = stream->history_count[h - 1];
+    }
+    if (count > 0) {
+        memcpy(stream->history[0], ranges, count * sizeof(stream_range_t));
+    }
+    stream->history_count[0] = count;
+    return offset;
+}
+
+void stream_fence(stream_t *stream) {
+    if (stream->strategy != STREAM_PERSISTENT) {
+        return;
+    }
+    // a frame drawn again without an upload fences the same segment twice
+    if (stream->fences[stream->segment]) {
+        glDeleteSync(stream->fences[stream->segment]);
+    }
+    stream->fences[stream->segment] =
+            glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void stream_terminate(stream_t *stream) {
+    for (int s = 0; s < STREAM_SEGMENTS; s++) {
+        if (stream->fences[s]) {
+            glDeleteSync(stream->fences[s]);
+            stream->fences[s] = NULL;
+        }
+    }
+    if (stream->buffer) {
+        if (stream->mapped) {
+            glBindBuffer(stream->target, stream->buffer);
+            glUnmapBuffer(stream->target);
+            stream->mapped = NULL;
+        }
+        glDeleteBuffers(1, &stream->buffer);
+        stream->buffer = 0;
+    }
+    stream->uploaded = 0;
+}
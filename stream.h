@@ -0,0 +1,93 @@
+//
+// Created by dbrent on 4/14/21.
+//
+
+#ifndef SAND_STREAM_H
+#define SAND_STREAM_H
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// persistent streams cycle through this many segments so the cpu writes
+// one while the gpu may still read the other two
+#define STREAM_SEGMENTS 3
+
+typedef enum {
+    // glBufferSubData into the same storage every frame, the driver copies
+    // or stalls if the gpu still reads it
+    STREAM_SUBDATA,
+    // glBufferData(NULL) first so the driver can hand out fresh storage
+    // instead of waiting, then glBufferSubData
+    STREAM_ORPHAN,
+    // ARB_buffer_storage: one persistently mapped coherent buffer of
+    // STREAM_SEGMENTS segments, written in turn and fenced after every draw
+    STREAM_PERSISTENT
+} stream_strategy_e;
+
+#define STREAM_STRATEGIES 3
+
+// most ranges one stream_upload_ranges() call takes
+#define STREAM_RANGES 64
+
+// bytes offset .. offset + size - 1 of an upload
+typedef struct {
+    size_t offset;
+    size_t size;
+} stream_range_t;
+
+// a buffer the cpu refills every frame
+typedef struct {
+    stream_strategy_e strategy;
+    GLenum target;
+    GLuint buffer;
+    size_t segment_size;
+    int segment;
+    void *mapped;
+    GLsync fences[STREAM_SEGMENTS];
+    // whether the buffer (subdata) or each segment (persistent) holds a
+    // complete upload that ranges can be patched into
+    bool filled[STREAM_SEGMENTS];
+    // the ranges of the last STREAM_SEGMENTS - 1 uploads, newest first. a
+    // persistent segment is that many uploads behind when it comes round
+    // again. a count of -1 stands for everything.
+    stream_range_t history[STREAM_SEGMENTS - 1][STREAM_RANGES];
+    int history_count[STREAM_SEGMENTS - 1];
+    // bytes copied to GL since stream_init()
+    size_t uploaded;
+} stream_t;
+
+// parses a --stream argument, exits on an unknown strategy
+stream_strategy_e stream_strategy_parse(const char *name);
+
+const char *stream_strategy_name(stream_strategy_e strategy);
+
+// segments of size bytes a stream of strategy allocates on the current
+// context, STREAM_SEGMENTS for a persistent ring and 1 otherwise
+int stream_segments(stream_strategy_e strategy);
+
+// creates the buffer behind stream, bound to target, for uploads of up to
+// size bytes. falls back to STREAM_ORPHAN when the context has no
+// ARB_buffer_storage.
+void stream_init(stream_t *stream, stream_strategy_e strategy, GLenum target,
+                 size_t size);
+
+// copies size bytes into the stream and returns the byte offset in the
+// buffer they landed at. the buffer is left bound to the stream's target.
+size_t stream_upload(stream_t *stream, const void *data, size_t size);
+
+// like stream_upload() but only copies the count ranges of data that
+// changed since the previous upload, where the strategy keeps the old
+// contents. orphaning throws them away and always copies all size bytes, as
+// does a count of -1.
+size_t stream_upload_ranges(stream_t *stream, const void *data, size_t size,
+                            const stream_range_t *ranges, int count);
+
+// call after the draw that reads the last upload, persistent streams wait
+// on this fence before writing the segment again
+void stream_fence(stream_t *stream);
+
+void stream_terminate(stream_t *stream);
+
+#endif //SAND_STREAM_H
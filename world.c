@@ -0,0 +1,331 @@
+//
+// Created by dbrent on 4/17/21.
+//
+
+#include "world.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORLD_CHUNK_CELLS (WORLD_CHUNK * WORLD_CHUNK)
+
+// a chunk with grains outside the window
+typedef struct {
+    bool used;
+    int32_t cx;
+    int32_t cy;
+    // WORLD_CHUNK_CELLS materials laid out like sim_region_materials()
+    // writes them, NULL while evicted
+    uint8_t *cells;
+    // record in the store file while evicted
+    long record;
+} world_entry_t;
+
+int64_t world_origin_x;
+int64_t world_origin_y;
+int world_resident_limit = 1024;
+
+// open addressing with linear probing, capacity is a power of two and at
+// most half full
+static world_entry_t *table;
+static int table_capacity;
+static int table_count;
+static int resident;
+
+// evicted chunks are fixed size records, the ones read back are reused
+static char store_path[1024];
+static FILE *store;
+static long store_records;
+static long *free_records;
+static int free_count;
+static int free_capacity;
+
+static uint32_t chunk_hash(int32_t cx, int32_t cy) {
+    uint64_t k = (uint64_t) (uint32_t) cx << 32 | (uint32_t) cy;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (uint32_t) k;
+}
+
+// the slot holding cx, cy, or the empty slot it would go in
+static int table_find(int32_t cx, int32_t cy) {
+    int mask = table_capacity - 1;
+    int slot = (int) (chunk_hash(cx, cy) & mask);
+    while (table[slot].used &&
+           (table[slot].cx != cx || table[slot].cy != cy)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void table_grow() {
+    world_entry_t *old = table;
+    int old_capacity = table_capacity;
+    table_capacity = table_capacity ? table_capacity * 2 : 256;
+    table = calloc(table_capacity, sizeof(world_entry_t));
+    checkm(table);
+    for (int s = 0; s < old_capacity; s++) {
+        if (old[s].used) {
+            table[table_find(old[s].cx, old[s].cy)] = old[s];
+        }
+    }
+    free(old);
+}
+
+// empties slot and pulls the entries after it back, so no probe sequence
+// runs into a hole
+static void table_remove(int slot) {
+    int mask = table_capacity - 1;
+    int hole = slot;
+    for (int next = (hole + 1) & mask; table[next].used;
+         next = (next + 1) & mask) {
+        int home = (int) (chunk_hash(table[next].cx, table[next].cy) & mask);
+        // next can fill the hole unless its home lies between the two
+        bool stays = hole <= next ? hole < home && home <= next
+                                  : hole < home || home <= next;
+        if (!stays) {
+            table[hole] = table[next];
+            hole = next;
+        }
+    }
+    table[hole].used = false;
+    table[hole].cells = NULL;
+    table_count--;
+}
+
+static void store_open() {
+    store = fopen(store_path, "w+b");
+    if (store == NULL) {
+        printf("Could not open the world store %s\n", store_path);
+        exit(-1);
+    }
+}
+
+static void store_seek(long record) {
+    if (fseek(store, record * WORLD_CHUNK_CELLS, SEEK_SET) != 0) {
+        printf("Could not seek in the world store\n");
+        exit(-1);
+    }
+}
+
+static void evict(world_entry_t *entry) {
+    if (store == NULL) {
+        store_open();
+    }
+    entry->record = free_count > 0 ? free_records[--free_count]
+                                   : store_records++;
+    store_seek(entry->record);
+    if (fwrite(entry->cells, 1, WORLD_CHUNK_CELLS, store) !=
+        WORLD_CHUNK_CELLS) {
+        printf("Could not write to the world store\n");
+        exit(-1);
+    }
+    free(entry->cells);
+    entry->cells = NULL;
+    resident--;
+}
+
+static void store_release(long record) {
+    if (free_count == free_capacity) {
+        free_capacity = free_capacity ? free_capacity * 2 : 64;
+        free_records = realloc(free_records, free_capacity * sizeof(long));
+        checkm(free_records);
+    }
+    free_records[free_count++] = record;
+}
+
+// keeps the materials of chunk cx, cy unless they are all empty
+static void chunk_put(int32_t cx, int32_t cy, const uint8_t *cells) {
+    int c = 0;
+    while (c < WORLD_CHUNK_CELLS && cells[c] == 0) {
+        c++;
+    }
+    if (c == WORLD_CHUNK_CELLS) {
+        return;
+    }
+    if ((table_count + 1) * 2 > table_capacity) {
+        table_grow();
+    }
+    world_entry_t *entry = &table[table_find(cx, cy)];
+    entry->used = true;
+    entry->cx = cx;
+    entry->cy = cy;
+    entry->cells = malloc(WORLD_CHUNK_CELLS);
+    checkm(entry->cells);
+    memcpy(entry->cells, cells, WORLD_CHUNK_CELLS);
+    table_count++;
+    resident++;
+}
+
+// moves the materials of chunk cx, cy out of the world into cells, from
+// memory or the store file. returns false when the chunk is empty.
+static bool chunk_take(int32_t cx, int32_t cy, uint8_t *cells) {
+    if (table_count == 0) {
+        return false;
+    }
+    int slot = table_find(cx, cy);
+    world_entry_t *entry = &table[slot];
+    if (!entry->used) {
+        return false;
+    }
+    if (entry->cells) {
+        memcpy(cells, entry->cells, WORLD_CHUNK_CELLS);
+        free(entry->cells);
+        resident--;
+    } else {
+        store_seek(entry->record);
+        if (fread(cells, 1, WORLD_CHUNK_CELLS, store) != WORLD_CHUNK_CELLS) {
+            printf("Could not read from the world store\n");
+            exit(-1);
+        }
+        store_release(entry->record);
+    }
+    table_remove(slot);
+    return true;
+}
+
+static int32_t window_cx;
+static int32_t window_cy;
+
+// chunks from the centre of the window, along the farther axis
+static int64_t window_distance(const world_entry_t *entry) {
+    int64_t dx = llabs(2 * (int64_t) entry->cx + 1 -
+                       (2 * (int64_t) window_cx + WORLD_CHUNKS_X));
+    int64_t dy = llabs(2 * (int64_t) entry->cy + 1 -
+                       (2 * (int64_t) window_cy + WORLD_CHUNKS_Y));
+    return dx > dy ? dx : dy;
+}
+
+static int farther(const void *a, const void *b) {
+    int64_t da = window_distance(*(world_entry_t *const *) a);
+    int64_t db = window_distance(*(world_entry_t *const *) b);
+    return (da < db) - (da > db);
+}
+
+// writes the chunks farthest from the window to the store file until at
+// most world_resident_limit are left in memory
+static void evict_farthest() {
+    if (resident <= world_resident_limit) {
+        return;
+    }
+    world_entry_t **entries = malloc(resident * sizeof(world_entry_t *));
+    checkm(entries);
+    int count = 0;
+    for (int s = 0; s < table_capacity; s++) {
+        if (table[s].used && table[s].cells) {
+            entries[count++] = &table[s];
+        }
+    }
+    qsort(entries, count, sizeof(world_entry_t *), farther);
+    int excess = resident - (world_resident_limit > 0 ? world_resident_limit
+                                                      : 0);
+    for (int e = 0; e < excess; e++) {
+        evict(entries[e]);
+    }
+    free(entries);
+}
+
+void world_init(const char *path) {
+    world_origin_x = 0;
+    world_origin_y = 0;
+    window_cx = 0;
+    window_cy = 0;
+    snprintf(store_path, sizeof(store_path), "%s", path);
+}
+
+// chunk holding world cell v, rounding towards minus infinity
+static int32_t chunk_of(int64_t v) {
+    return (int32_t) ((v >= 0 ? v : v - WORLD_CHUNK + 1) / WORLD_CHUNK);
+}
+
+static bool in_window(int32_t cx, int32_t cy, int32_t min_cx,
+                      int32_t min_cy) {
+    return cx >= min_cx && cx < min_cx + WORLD_CHUNKS_X &&
+           cy >= min_cy && cy < min_cy + WORLD_CHUNKS_Y;
+}
+
+bool world_move(int64_t origin_x, int64_t origin_y) {
+    int32_t cx = chunk_of(origin_x);
+    int32_t cy = chunk_of(origin_y);
+    if (cx == window_cx && cy == window_cy) {
+        return false;
+    }
+    static uint8_t cells[WORLD_CHUNK_CELLS];
+
+    for (int wy = 0; wy < WORLD_CHUNKS_Y; wy++) {
+        for (int wx = 0; wx < WORLD_CHUNKS_X; wx++) {
+            if (!in_window(window_cx + wx, window_cy + wy, cx, cy)) {
+                sim_region_materials(wx * WORLD_CHUNK, wy * WORLD_CHUNK,
+                                     WORLD_CHUNK, WORLD_CHUNK, cells);
+                chunk_put(window_cx + wx, window_cy + wy, cells);
+            }
+        }
+    }
+    // a jump farther than the window drops every grain all the same
+    int64_t dx = ((int64_t) window_cx - cx) * WORLD_CHUNK;
+    int64_t dy = ((int64_t) window_cy - cy) * WORLD_CHUNK;
+    sim_shift((int) (llabs(dx) < W_WIDTH ? dx : W_WIDTH),
+              (int) (llabs(dy) < W_HEIGHT ? dy : W_HEIGHT));
+
+    int32_t old_cx = window_cx;
+    int32_t old_cy = window_cy;
+    window_cx = cx;
+    window_cy = cy;
+    world_origin_x = (int64_t) cx * WORLD_CHUNK;
+    world_origin_y = (int64_t) cy * WORLD_CHUNK;
+    for (int wy = 0; wy < WORLD_CHUNKS_Y; wy++) {
+        for (int wx = 0; wx < WORLD_CHUNKS_X; wx++) {
+            if (!in_window(cx + wx, cy + wy, old_cx, old_cy) &&
+                chunk_take(cx + wx, cy + wy, cells)) {
+                sim_region_load(wx * WORLD_CHUNK, wy * WORLD_CHUNK,
+                                WORLD_CHUNK, WORLD_CHUNK, cells);
+            }
+        }
+    }
+    evict_farthest();
+    return true;
+}
+
+void world_follow(double x, double y) {
+    double centre_x = (double) world_origin_x + W_WIDTH / 2.0;
+    double centre_y = (double) world_origin_y + W_HEIGHT / 2.0;
+    if (fabs(x - centre_x) <= WORLD_CHUNK &&
+        fabs(y - centre_y) <= WORLD_CHUNK) {
+        return;
+    }
+    // the origin whose window centre is nearest to x, y
+    world_move((int64_t) floor(x - W_WIDTH / 2.0 + WORLD_CHUNK / 2.0),
+               (int64_t) floor(y - W_HEIGHT / 2.0 + WORLD_CHUNK / 2.0));
+}
+
+int world_chunks_resident() {
+    return resident;
+}
+
+int world_chunks_evicted() {
+    return table_count - resident;
+}
+
+void world_terminate() {
+    for (int s = 0; s < table_capacity; s++) {
+        free(table[s].cells);
+    }
+    free(table);
+    table = NULL;
+    table_capacity = 0;
+    table_count = 0;
+    resident = 0;
+    free(free_records);
+    free_records = NULL;
+    free_count = 0;
+    free_capacity = 0;
+    store_records = 0;
+    if (store) {
+        fclose(store);
+        store = NULL;
+        remove(store_path);
+    }
+}
@@ -0,0 +1,60 @@
+//
+// Created by dbrent on 4/17/21.
+//
+
+#ifndef SAND_WORLD_H
+#define SAND_WORLD_H
+
+#include "sim.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the world has no edges. only the W_WIDTH x W_HEIGHT window whose top-left
+// cell is world_origin is simulated, everything else sits in a hash of
+// WORLD_CHUNK sized chunks that only exist where there are grains. the
+// edges of the window act as walls until it moves on.
+//
+// WORLD_CHUNK divides the window, so it always covers whole chunks. the sim
+// keeps its own smaller CHUNK_SIZE chunks for waking.
+#define WORLD_CHUNK 120
+#define WORLD_CHUNKS_X (W_WIDTH / WORLD_CHUNK)
+#define WORLD_CHUNKS_Y (W_HEIGHT / WORLD_CHUNK)
+
+_Static_assert(W_WIDTH % WORLD_CHUNK == 0 && W_HEIGHT % WORLD_CHUNK == 0,
+               "the window has to be whole world chunks");
+
+// world cell of window cell 0, 0, always a multiple of WORLD_CHUNK. only
+// the thread driving the sim may read or move it.
+extern int64_t world_origin_x;
+extern int64_t world_origin_y;
+
+// chunks outside the window held in memory. past this many the ones
+// farthest from the window are written to the store file, and read back
+// when the window comes near them again.
+extern int world_resident_limit;
+
+// puts the window at the world origin over an empty world. evicted chunks
+// go to a file at store_path, created on the first eviction and removed by
+// world_terminate(). call after sim_init().
+void world_init(const char *store_path);
+
+// moves the window so its top-left cell is origin_x, origin_y rounded down
+// to whole chunks. the chunks it leaves are stored, the ones it reaches are
+// loaded and the grains it keeps are shifted along, see sim_shift(). only
+// between ticks. returns whether the window moved.
+bool world_move(int64_t origin_x, int64_t origin_y);
+
+// re-centres the window on world cell x, y once that is more than a chunk
+// off the window's centre, so a camera hovering over a chunk edge doesn't
+// move it back and forth every tick
+void world_follow(double x, double y);
+
+// chunks with grains outside the window, in memory and in the store file
+int world_chunks_resident();
+
+int world_chunks_evicted();
+
+void world_terminate();
+
+#endif //SAND_WORLD_H